@@ -2,66 +2,72 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "gpu/bundle.h"
+#include "gpu/capture.h"
 #include "gpu/cmd.h"
 #include "gpu/enum.h"
 #include "gpu/frame.h"
 #include "gpu/mm.h"
 #include "gpu/raster.h"
 #include "gpu/verts.h"
+#include "gpu/xform.h"
 #include "util/matrix.h"
 
-void draw_frame(uint8_t *frame_out, int width, int height, int counter) {
-    mat4 viewport = mat4_new();
-    mat4_translate(&viewport, (width - 0.5f) / 2.0f, (height - 0.5f) / 2.0f, -1.0f);
-    mat4_scale(&viewport, (width - 0.5f) / 2.0f, -(height - 0.5f) / 2.0f, 1.0f);
+typedef struct {
+    gpu_verts *cube;
+    gpu_bundle *cubes;
+} scene_t;
 
-    float rotate = counter / 10.0;
-    mat4 model = mat4_new();
-    mat4_translate(&model, 0, 0, 10.0f);
-    mat4_rotate(&model, rotate, 1.0f, 1.0f, 0);
-    mat4_translate(&model, 3.0f, 0, 0);
+gpu_verts *cube_new() {
+    #include "shapes.h"
 
-    mat4 model2 = model;
-    mat4_translate(&model2, -6.0f, 0.0f, 0.0f);
+    gpu_verts *cube = gpu_verts_new_layout(36, GPU_VERTS_SOA);
+    gpu_color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    for (int i = 0; i < 36; i++) {
+        *gpu_verts_pos(cube, i) = ((gpu_pos *)cube3d)[i];
+        *gpu_verts_color(cube, i) = white;
+    }
+    return cube;
+}
 
-    mat4 view = mat4_new();
-    mat4_perspective(&view, 45.0f, (float)width / (float)height, 0.1f, 100.0f);
+// the pair of cubes never changes shape, only where it is looked at from,
+// so it is recorded once and replayed under a new matrix every frame. both
+// share the cube's vertices, the second one is drawn as a wireframe
+gpu_bundle *cubes_new(gpu_verts *cube) {
+    mat4 mats[2] = {mat4_new(), mat4_new()};
+    mat4_translate(&mats[0], 3.0f, 0, 0);
+    mat4_translate(&mats[1], -3.0f, 0, 0);
+    gpu_color colors[2] = {
+        {0xFF, 0xFF, 0xFF, 0xFF},
+        {0x80, 0xC0, 0xFF, 0xFF},
+    };
+    gpu_cmd *cmds[2] = {
+        gpu_cmd_new_instanced(GPU_TRIANGLE, cube, &mats[0], &colors[0], 1, false),
+        gpu_cmd_new_instanced(GPU_TRIANGLE, cube, &mats[1], &colors[1], 1, true),
+    };
+    return gpu_bundle_new(cmds, 2);
+}
 
-    /*
-    mat4_mul(model, view);
-    mat4_mul(model, viewport);
-    mat4_mul(model2, view);
-    mat4_mul(model2, viewport);
-    */
+void draw_frame(uint8_t *frame_out, int width, int height, int pitch, int counter,
+                scene_t *scene, gpu_capture *cap) {
+    gpu_xform xf;
+    gpu_xform_init(&xf);
+    gpu_xform_viewport(&xf, 0, 0, width, height);
+    gpu_xform_mode(&xf, GPU_PROJECTION);
+    gpu_xform_perspective(&xf, 45.0f, (float)width / (float)height, 0.1f, 100.0f);
+    gpu_xform_mode(&xf, GPU_MODELVIEW);
+    gpu_xform_translate(&xf, 0, 0, 10.0f);
+    gpu_xform_rotate(&xf, counter / 10.0, 1.0f, 1.0f, 0);
 
-    gpu_frame frame = gpu_frame_init(frame_out, width, height);
+    // SDL's ARGB8888 is a packed word, which is B, G, R, A in memory on little-endian
+    gpu_frame frame = gpu_frame_init_target(frame_out, width, height, pitch, GPU_BGRA8);
+    gpu_frame_capture(&frame, cap);
     gpu_color clear_color = {0x00, 0x00, 0x00, 0xFF};
     gpu_frame_clear(&frame, clear_color);
 
-    #include "shapes.h"
-
-    gpu_verts *v1 = gpu_verts_new(36);
-    for (int i = 0; i < 36; i++) {
-        v1->v[i].pos = ((gpu_pos *)cube3d)[i];
-    }
-    gpu_verts *v2 = gpu_verts_copy(v1);
-    /*
-    gpu_verts_transform(model, v1, v1);
-    gpu_verts_transform(model2, v2, v2);
-    */
-    gpu_verts_transform(&model, v1, v1);
-    gpu_verts_transform(&view, v1, v1);
-    gpu_verts_transform(&viewport, v1, v1);
-    gpu_verts_transform(&model2, v2, v2);
-    gpu_verts_transform(&view, v2, v2);
-    gpu_verts_transform(&viewport, v2, v2);
-
-    gpu_cmd *cmd1 = gpu_cmd_new(GPU_TRIANGLE, v1, false);
-    gpu_cmd *cmd2 = gpu_cmd_new(GPU_TRIANGLE, v2, true);
-    gpu_cmd_draw(cmd1, &frame);
-    gpu_cmd_draw(cmd2, &frame);
-    gpu_cmd_free(cmd1);
-    gpu_cmd_free(cmd2);
+    gpu_frame_execute(&frame, scene->cubes, gpu_xform_mvp(&xf));
+    gpu_frame_render(&frame);
+    gpu_frame_free(&frame);
 }
 
 int main() {
@@ -76,6 +82,15 @@ int main() {
             SDL_PIXELFORMAT_ARGB8888,
             SDL_TEXTUREACCESS_STREAMING,
             width, height);
+    // LIBGPU_CAPTURE=file records every frame for the replay tool
+    gpu_capture *cap = NULL;
+    if (getenv("LIBGPU_CAPTURE")) {
+        cap = gpu_capture_open(getenv("LIBGPU_CAPTURE"));
+    }
+    scene_t scene = {
+        .cube = cube_new(),
+    };
+    scene.cubes = cubes_new(scene.cube);
     int i = 0;
     bool done = false;
     bool click = false;
@@ -114,7 +129,7 @@ int main() {
         void *pixels = NULL;
         int pitch = 0;
         SDL_LockTexture(texture, NULL, &pixels, &pitch);
-        draw_frame(pixels, width, height, i);
+        draw_frame(pixels, width, height, pitch, i, &scene, cap);
         if (!click) {
             i += 50;
         }
@@ -122,6 +137,11 @@ int main() {
         SDL_RenderCopy(renderer, texture, NULL, NULL);
         SDL_RenderPresent(renderer);
     }
+    gpu_bundle_free(scene.cubes);
+    gpu_verts_free(scene.cube);
+    if (cap) {
+        gpu_capture_close(cap);
+    }
     SDL_DestroyWindow(window);
     SDL_Quit();
     return 0;
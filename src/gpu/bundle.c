@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bundle.h"
+#include "cmd.h"
+#include "mm.h"
+#include "verts.h"
+
+// takes ownership of the commands on success. everything that can be
+// worked out ahead of time (validation, bounds, scratch size) is done
+// here so executing the bundle is just drawing.
+gpu_bundle *gpu_bundle_new(gpu_cmd **cmds, uint32_t len) {
+    uint32_t scratch = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (! gpu_cmd_valid(cmds[i])) {
+            fprintf(stderr, "gpu_bundle_new(): command %u is invalid\n", i);
+            return NULL;
+        }
+        if (cmds[i]->verts && cmds[i]->verts->len > scratch) {
+            scratch = cmds[i]->verts->len;
+        }
+    }
+
+    gpu_bundle *bundle = calloc(1, sizeof(gpu_bundle));
+    bundle->refs = 1;
+    bundle->len = len;
+    bundle->cmds = memdup(cmds, sizeof(gpu_cmd *) * len);
+    bundle->bounds = calloc(len, sizeof(gpu_bounds));
+    bundle->scratch = gpu_verts_new(scratch);
+    bundle->flat = true;
+    bool first = true;
+    for (uint32_t i = 0; i < len; i++) {
+        gpu_cmd *cmd = cmds[i];
+        if (cmd->bundle) {
+            bundle->flat = false;
+            continue;
+        }
+        if (cmd->instances) {
+            bundle->flat = false;
+        }
+        gpu_verts_bounds(cmd->verts, &bundle->bounds[i]);
+        gpu_bounds *b = &bundle->bounds[i], *t = &bundle->total;
+        if (first) {
+            *t = *b;
+            first = false;
+            continue;
+        }
+        t->min.x = b->min.x < t->min.x ? b->min.x : t->min.x;
+        t->min.y = b->min.y < t->min.y ? b->min.y : t->min.y;
+        t->min.z = b->min.z < t->min.z ? b->min.z : t->min.z;
+        t->max.x = b->max.x > t->max.x ? b->max.x : t->max.x;
+        t->max.y = b->max.y > t->max.y ? b->max.y : t->max.y;
+        t->max.z = b->max.z > t->max.z ? b->max.z : t->max.z;
+    }
+    return bundle;
+}
+
+gpu_bundle *gpu_bundle_ref(gpu_bundle *bundle) {
+    bundle->refs++;
+    return bundle;
+}
+
+void gpu_bundle_free(gpu_bundle *bundle) {
+    if (bundle == NULL || --bundle->refs > 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < bundle->len; i++) {
+        gpu_cmd_free(bundle->cmds[i]);
+    }
+    gpu_verts_free(bundle->scratch);
+    free(bundle->bounds);
+    free(bundle->cmds);
+    free(bundle);
+}
+
+void gpu_bundle_draw(gpu_bundle *bundle, gpu_frame *frame, const mat4 *top) {
+    if (top == NULL) {
+        for (uint32_t i = 0; i < bundle->len; i++) {
+            gpu_cmd_draw(bundle->cmds[i], frame);
+        }
+        return;
+    }
+    if (bundle->flat && ! gpu_bounds_visible(&bundle->total, top, frame->width, frame->height)) {
+        return;
+    }
+    for (uint32_t i = 0; i < bundle->len; i++) {
+        gpu_cmd *cmd = bundle->cmds[i];
+        const gpu_bounds *bounds = cmd->bundle ? NULL : &bundle->bounds[i];
+        gpu_cmd_draw_under(cmd, frame, top, bounds, bundle->scratch);
+    }
+}
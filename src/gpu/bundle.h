@@ -0,0 +1,11 @@
+#ifndef GPU_BUNDLE_H
+#define GPU_BUNDLE_H
+
+#include "types.h"
+
+extern gpu_bundle *gpu_bundle_new(gpu_cmd **cmds, uint32_t len);
+extern gpu_bundle *gpu_bundle_ref(gpu_bundle *bundle);
+extern void gpu_bundle_free(gpu_bundle *bundle);
+extern void gpu_bundle_draw(gpu_bundle *bundle, gpu_frame *frame, const mat4 *top);
+
+#endif
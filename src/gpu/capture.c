@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "capture.h"
+#include "verts.h"
+
+struct gpu_capture {
+    FILE *fd;
+    // set after the first failed write, the rest of the capture is dropped
+    bool failed;
+    // textures are not recorded, which is reported once
+    bool untextured;
+};
+
+typedef struct {
+    const void *data;
+    uint32_t size;
+} gpu_capture_chunk;
+
+static void gpu_capture_put(gpu_capture *cap, const void *data, size_t size) {
+    if (cap->failed || size == 0) {
+        return;
+    }
+    if (fwrite(data, 1, size, cap->fd) != size) {
+        fprintf(stderr, "gpu_capture_write(): Short write, capture stopped\n");
+        cap->failed = true;
+    }
+}
+
+static void gpu_capture_write(gpu_capture *cap, uint32_t tag,
+                              const gpu_capture_chunk *chunks, int count) {
+    static const uint8_t pad[GPU_CAPTURE_ALIGN] = {0};
+    uint32_t size = 0;
+    for (int i = 0; i < count; i++) {
+        size += chunks[i].size;
+    }
+    uint32_t padding = GPU_CAPTURE_PADDING(size);
+    gpu_capture_record record = {tag, size + padding};
+    gpu_capture_put(cap, &record, sizeof(record));
+    for (int i = 0; i < count; i++) {
+        gpu_capture_put(cap, chunks[i].data, chunks[i].size);
+    }
+    gpu_capture_put(cap, pad, padding);
+}
+
+gpu_capture *gpu_capture_open(const char *path) {
+    FILE *fd = fopen(path, "wb");
+    if (fd == NULL) {
+        fprintf(stderr, "gpu_capture_open(): could not open %s\n", path);
+        return NULL;
+    }
+    gpu_capture_header header = {GPU_CAPTURE_MAGIC, GPU_CAPTURE_VERSION};
+    if (fwrite(&header, sizeof(header), 1, fd) != 1) {
+        fprintf(stderr, "gpu_capture_open(): could not write %s\n", path);
+        fclose(fd);
+        return NULL;
+    }
+
+    gpu_capture *cap = calloc(1, sizeof(gpu_capture));
+    if (cap == NULL) {
+        fclose(fd);
+        return NULL;
+    }
+    cap->fd = fd;
+    return cap;
+}
+
+void gpu_capture_close(gpu_capture *cap) {
+    if (fclose(cap->fd) != 0 && ! cap->failed) {
+        fprintf(stderr, "gpu_capture_close(): Write failed, capture is incomplete\n");
+    }
+    free(cap);
+}
+
+void gpu_capture_clear(gpu_capture *cap, gpu_color color) {
+    gpu_capture_chunk chunk = {&color, sizeof(color)};
+    gpu_capture_write(cap, GPU_CAPTURE_CLEAR, &chunk, 1);
+}
+
+// bundles are flattened into the commands they contain, with any top
+// level matrix folded into per-instance matrices, so replay never needs
+// to know bundles exist
+static void gpu_capture_cmd_under(gpu_capture *cap, gpu_cmd *cmd, const mat4 *top) {
+    if (cmd->bundle) {
+        mat4 m;
+        const mat4 *next = top;
+        if (cmd->mats) {
+            m = top ? *top : mat4_new();
+            mat4_mul(&m, cmd->mats);
+            next = &m;
+        }
+        for (uint32_t i = 0; i < cmd->bundle->len; i++) {
+            gpu_capture_cmd_under(cap, cmd->bundle->cmds[i], next);
+        }
+        return;
+    }
+
+    uint32_t instances = cmd->instances;
+    mat4 *mats = cmd->mats;
+    if (top) {
+        instances = instances ? instances : 1;
+        mats = malloc(sizeof(mat4) * instances);
+        if (cmd->instances) {
+            mat4_mul_array((mat4 *)top, mats, cmd->mats, instances);
+        } else {
+            mats[0] = *top;
+        }
+    }
+    // the file is always interleaved floats
+    gpu_verts *src = cmd->verts;
+    if (gpu_verts_packed(src)) {
+        src = gpu_verts_unpack(NULL, src);
+    }
+    gpu_vert *verts = src->v;
+    if (src->layout != GPU_VERTS_AOS) {
+        verts = malloc(sizeof(gpu_vert) * src->len);
+        for (uint32_t i = 0; i < src->len; i++) {
+            verts[i].pos = *gpu_verts_pos(src, i);
+            verts[i].color = *gpu_verts_color(src, i);
+            verts[i].tex = *gpu_verts_tex(src, i);
+        }
+    }
+    gpu_capture_cmd head = {
+        .primitive = cmd->primitive,
+        .wireframe = cmd->wireframe,
+        .len = cmd->verts->len,
+        .instances = instances,
+        .colors = cmd->colors != NULL,
+        .blend = cmd->blend,
+    };
+    if (cmd->tex && ! cap->untextured) {
+        fprintf(stderr, "gpu_capture_cmd_write(): Textures are not captured, replay draws vertex colors\n");
+        cap->untextured = true;
+    }
+    gpu_capture_chunk chunks[] = {
+        {&head, sizeof(head)},
+        {verts, sizeof(gpu_vert) * head.len},
+        {mats, sizeof(mat4) * head.instances},
+        {cmd->colors, head.colors ? sizeof(gpu_color) * head.instances : 0},
+    };
+    gpu_capture_write(cap, GPU_CAPTURE_CMD, chunks, 4);
+    if (mats != cmd->mats) {
+        free(mats);
+    }
+    if (verts != src->v) {
+        free(verts);
+    }
+    if (src != cmd->verts) {
+        gpu_verts_free(src);
+    }
+}
+
+void gpu_capture_cmd_write(gpu_capture *cap, gpu_cmd *cmd) {
+    gpu_capture_cmd_under(cap, cmd, NULL);
+}
+
+void gpu_capture_frame_end(gpu_capture *cap, gpu_frame *frame) {
+    gpu_capture_frame head = {frame->width, frame->height};
+    gpu_capture_chunk chunk = {&head, sizeof(head)};
+    gpu_capture_write(cap, GPU_CAPTURE_FRAME, &chunk, 1);
+    if (! cap->failed && fflush(cap->fd) != 0) {
+        fprintf(stderr, "gpu_capture_frame_end(): Write failed, capture stopped\n");
+        cap->failed = true;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef GPU_CAPTURE_H
+#define GPU_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+// On-disk layout of a command-stream capture. Everything is stored in host
+// byte order and every record is padded to 16 bytes, so a replay can point
+// gpu_verts and instance matrices straight into the mapped file:
+//
+//   gpu_capture_header
+//   gpu_capture_record [payload]  (repeated)
+//
+// CLEAR and CMD records belong to the frame closed by the next FRAME record.
+// A CMD payload is the header below, len vertices, then for instanced
+// commands one mat4 per instance and optionally one gpu_color per instance.
+
+#define GPU_CAPTURE_MAGIC   0x43555047 // "GPUC"
+#define GPU_CAPTURE_VERSION 3
+#define GPU_CAPTURE_ALIGN   16
+
+// bytes of padding after a payload of size, so the next record starts aligned
+#define GPU_CAPTURE_PADDING(size) \
+    ((GPU_CAPTURE_ALIGN - ((sizeof(gpu_capture_record) + (size)) & (GPU_CAPTURE_ALIGN - 1))) & \
+     (GPU_CAPTURE_ALIGN - 1))
+
+enum {
+    GPU_CAPTURE_CLEAR = 1,
+    GPU_CAPTURE_CMD,
+    GPU_CAPTURE_FRAME,
+};
+
+typedef struct {
+    uint32_t magic, version;
+    uint32_t reserved[2];
+} gpu_capture_header;
+
+typedef struct {
+    uint32_t tag, size;
+} gpu_capture_record;
+
+typedef struct {
+    uint32_t primitive, wireframe, len;
+    uint32_t instances, colors;
+    // also keeps v, and so the mat4s after it, 16 byte aligned
+    uint32_t blend;
+    gpu_vert v[];
+} gpu_capture_cmd;
+
+typedef struct {
+    uint32_t width, height;
+} gpu_capture_frame;
+
+// a record, plus for CMD records the command built from it at load time
+typedef struct {
+    const gpu_capture_record *record;
+    gpu_cmd *cmd;
+} gpu_replay_op;
+
+typedef struct {
+    const uint8_t *map;
+    size_t size;
+    gpu_replay_op *ops;
+    uint32_t len;
+    // index into ops of the FRAME record closing each frame
+    uint32_t *frames;
+    uint32_t frame_count;
+} gpu_replay;
+
+gpu_capture *gpu_capture_open(const char *path);
+void gpu_capture_close(gpu_capture *cap);
+void gpu_capture_clear(gpu_capture *cap, gpu_color color);
+void gpu_capture_cmd_write(gpu_capture *cap, gpu_cmd *cmd);
+void gpu_capture_frame_end(gpu_capture *cap, gpu_frame *frame);
+
+gpu_replay *gpu_replay_open(const char *path);
+void gpu_replay_close(gpu_replay *replay);
+uint32_t gpu_replay_frames(gpu_replay *replay);
+bool gpu_replay_size(gpu_replay *replay, uint32_t index, uint32_t *width, uint32_t *height);
+bool gpu_replay_frame(gpu_replay *replay, uint32_t index, gpu_frame *frame);
+
+#endif
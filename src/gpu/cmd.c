@@ -1,31 +1,177 @@
 #include <stdlib.h>
 
+#include "bundle.h"
 #include "cmd.h"
 #include "enum.h"
+#include "frame.h"
+#include "mm.h"
 #include "raster.h"
 #include "verts.h"
 
+static const gpu_color white = {0xFF, 0xFF, 0xFF, 0xFF};
+
 gpu_cmd *gpu_cmd_new(uint32_t primitive, gpu_verts *verts, bool wireframe) {
-    gpu_cmd *cmd = malloc(sizeof(gpu_cmd));
+    gpu_cmd *cmd = calloc(1, sizeof(gpu_cmd));
+    if (cmd == NULL) {
+        return NULL;
+    }
     cmd->primitive = primitive;
-    cmd->verts = verts;
+    cmd->verts = gpu_verts_ref(verts);
     cmd->wireframe = wireframe;
     return cmd;
 }
 
+// mats (and colors, if given) are copied, one entry per instance
+gpu_cmd *gpu_cmd_new_instanced(uint32_t primitive, gpu_verts *verts,
+                               const mat4 *mats, const gpu_color *colors,
+                               uint32_t instances, bool wireframe) {
+    gpu_cmd *cmd = gpu_cmd_new(primitive, verts, wireframe);
+    if (cmd == NULL) {
+        return NULL;
+    }
+    cmd->instances = instances;
+    cmd->mats = memdup((void *)mats, sizeof(mat4) * instances);
+    if (colors) {
+        cmd->colors = memdup((void *)colors, sizeof(gpu_color) * instances);
+    }
+    cmd->world = malloc(sizeof(mat4) * instances);
+    cmd->scratch = gpu_verts_new_layout(verts->len, verts->layout);
+    return cmd;
+}
+
+// like gpu_cmd_new_instanced(), but mats and colors are used in place and
+// must outlive the command. mats must be 16 byte aligned.
+gpu_cmd *gpu_cmd_wrap_instanced(uint32_t primitive, gpu_verts *verts,
+                                mat4 *mats, gpu_color *colors,
+                                uint32_t instances, bool wireframe) {
+    gpu_cmd *cmd = gpu_cmd_new(primitive, verts, wireframe);
+    if (cmd == NULL) {
+        return NULL;
+    }
+    cmd->instances = instances;
+    cmd->mats = mats;
+    cmd->colors = colors;
+    cmd->borrowed = true;
+    cmd->world = malloc(sizeof(mat4) * instances);
+    cmd->scratch = gpu_verts_new_layout(verts->len, verts->layout);
+    if (cmd->world == NULL || cmd->scratch == NULL) {
+        gpu_cmd_free(cmd);
+        return NULL;
+    }
+    return cmd;
+}
+
+gpu_cmd *gpu_cmd_new_bundle(gpu_bundle *bundle, const mat4 *top) {
+    gpu_cmd *cmd = calloc(1, sizeof(gpu_cmd));
+    if (cmd == NULL) {
+        return NULL;
+    }
+    cmd->bundle = gpu_bundle_ref(bundle);
+    if (top) {
+        cmd->mats = memdup((void *)top, sizeof(mat4));
+    }
+    return cmd;
+}
+
+// textures filled triangles with tex, which must outlive cmd. NULL goes
+// back to vertex colors.
+void gpu_cmd_texture(gpu_cmd *cmd, const gpu_tex *tex) {
+    cmd->tex = tex;
+}
+
+// blends filled triangles by their alpha: GPU_SRC_ALPHA for straight
+// colors, GPU_ONE for premultiplied ones, or 0 to draw them opaque
+void gpu_cmd_blend(gpu_cmd *cmd, uint32_t blend) {
+    cmd->blend = blend;
+}
+
 void gpu_cmd_free(gpu_cmd *cmd) {
-    free(cmd->verts);
+    gpu_verts_free(cmd->verts);
+    gpu_verts_free(cmd->scratch);
+    gpu_bundle_free(cmd->bundle);
+    if (! cmd->borrowed) {
+        free(cmd->mats);
+        free(cmd->colors);
+    }
+    free(cmd->world);
     free(cmd);
 }
 
-void gpu_cmd_draw(gpu_cmd *cmd, gpu_frame *frame) {
+bool gpu_cmd_valid(gpu_cmd *cmd) {
+    if (cmd->bundle) {
+        return true;
+    }
+    if (cmd->blend != 0 && cmd->blend != GPU_SRC_ALPHA && cmd->blend != GPU_ONE) {
+        return false;
+    }
+    switch (cmd->primitive) {
+    case GPU_TRIANGLE:
+        return cmd->verts->len % 3 == 0;
+    default:
+        return false;
+    }
+}
+
+// vertex colors are multiplied by color, the instance color or white
+static void gpu_cmd_draw_verts(gpu_cmd *cmd, gpu_frame *frame, gpu_verts *verts, gpu_color color) {
     switch (cmd->primitive) {
     case GPU_TRIANGLE:
-        for (int i = 0; i < cmd->verts->len - 2; i += 3) {
-            gpu_triangle(frame, cmd->verts, i, cmd->wireframe);
+        for (int i = 0; i + 2 < verts->len; i += 3) {
+            gpu_triangle(frame, verts, i, cmd, color);
         }
         break;
     default:
         abort();
     }
 }
+
+// draws cmd with every vertex additionally transformed by top. bounds, if
+// given, are the object space bounds of cmd->verts and let whole instances
+// be skipped once they are off screen.
+void gpu_cmd_draw_under(gpu_cmd *cmd, gpu_frame *frame, const mat4 *top,
+                        const gpu_bounds *bounds, gpu_verts *scratch) {
+    if (cmd->bundle) {
+        mat4 m = *top;
+        if (cmd->mats) {
+            mat4_mul(&m, cmd->mats);
+        }
+        gpu_bundle_draw(cmd->bundle, frame, &m);
+        return;
+    }
+    if (cmd->instances == 0) {
+        if (bounds && ! gpu_bounds_visible(bounds, top, frame->width, frame->height)) {
+            return;
+        }
+        gpu_verts_transform((mat4 *)top, scratch, cmd->verts);
+        gpu_cmd_draw_verts(cmd, frame, scratch, white);
+        return;
+    }
+    mat4_mul_array((mat4 *)top, cmd->world, cmd->mats, cmd->instances);
+    for (uint32_t i = 0; i < cmd->instances; i++) {
+        if (bounds && ! gpu_bounds_visible(bounds, &cmd->world[i], frame->width, frame->height)) {
+            continue;
+        }
+        gpu_verts_transform(&cmd->world[i], cmd->scratch, cmd->verts);
+        gpu_cmd_draw_verts(cmd, frame, cmd->scratch, cmd->colors ? cmd->colors[i] : white);
+    }
+}
+
+void gpu_cmd_draw(gpu_cmd *cmd, gpu_frame *frame) {
+    if (cmd->bundle) {
+        gpu_bundle_draw(cmd->bundle, frame, cmd->mats);
+        return;
+    }
+    if (cmd->instances == 0) {
+        gpu_verts *verts = cmd->verts;
+        if (gpu_verts_packed(verts)) {
+            // already in screen space, but still needs decoding
+            verts = cmd->scratch = gpu_verts_unpack(cmd->scratch, verts);
+        }
+        gpu_cmd_draw_verts(cmd, frame, verts, white);
+        return;
+    }
+    for (uint32_t i = 0; i < cmd->instances; i++) {
+        gpu_verts_transform(&cmd->mats[i], cmd->scratch, cmd->verts);
+        gpu_cmd_draw_verts(cmd, frame, cmd->scratch, cmd->colors ? cmd->colors[i] : white);
+    }
+}
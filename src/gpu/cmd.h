@@ -4,7 +4,19 @@
 #include "types.h"
 
 extern gpu_cmd *gpu_cmd_new(uint32_t primitive, gpu_verts *verts, bool wireframe);
+extern gpu_cmd *gpu_cmd_new_instanced(uint32_t primitive, gpu_verts *verts,
+                                      const mat4 *mats, const gpu_color *colors,
+                                      uint32_t instances, bool wireframe);
+extern gpu_cmd *gpu_cmd_wrap_instanced(uint32_t primitive, gpu_verts *verts,
+                                       mat4 *mats, gpu_color *colors,
+                                       uint32_t instances, bool wireframe);
+extern gpu_cmd *gpu_cmd_new_bundle(gpu_bundle *bundle, const mat4 *top);
+extern void gpu_cmd_texture(gpu_cmd *cmd, const gpu_tex *tex);
+extern void gpu_cmd_blend(gpu_cmd *cmd, uint32_t blend);
 extern void gpu_cmd_free(gpu_cmd *cmd);
+extern bool gpu_cmd_valid(gpu_cmd *cmd);
 extern void gpu_cmd_draw(gpu_cmd *cmd, gpu_frame *frame);
+extern void gpu_cmd_draw_under(gpu_cmd *cmd, gpu_frame *frame, const mat4 *top,
+                               const gpu_bounds *bounds, gpu_verts *scratch);
 
 #endif
@@ -12,10 +12,32 @@
 #define GPU_UNSIGNED_INT        0x1405
 #define GPU_FLOAT               0x1406
 #define GPU_DOUBLE              0x140A
+#define GPU_HALF_FLOAT          0x140B
 
 #define GPU_POINT               0x0000
 #define GPU_LINE                0x0001
 #define GPU_TRIANGLE            0x0004
 #define GPU_QUAD                0x0007
 
+// blend source factors, see gpu_cmd_blend(). the destination is always
+// scaled by one minus the source alpha
+#define GPU_ONE                 0x0001
+#define GPU_SRC_ALPHA           0x0302
+
+#define GPU_MODELVIEW           0x1700
+#define GPU_PROJECTION          0x1701
+
+// render target formats, named by byte order in memory
+#define GPU_RGBA8               0x8058
+#define GPU_BGRA8               0x93A1
+#define GPU_RGB565              0x8D62
+// RGBA8 with sRGB encoded colors, blended in linear light
+#define GPU_SRGB8_ALPHA8        0x8C43
+
+// texture formats of 4x4 texel blocks. BC1 has 1 bit alpha (DXT1 RGBA),
+// BC3 is DXT5, and ETC1 is opaque.
+#define GPU_BC1                 0x83F1
+#define GPU_BC3                 0x83F3
+#define GPU_ETC1                0x8D64
+
 #endif
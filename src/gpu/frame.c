@@ -4,30 +4,96 @@
 #include <string.h>
 
 #include "frame.h"
+#include "capture.h"
 #include "cmd.h"
 #include "enum.h"
+#include "kernels.h"
 #include "pixel.h"
+#include "raster.h"
+
+static uint32_t gpu_format_sizeof(uint32_t format) {
+    switch (format) {
+    case GPU_RGBA8:
+    case GPU_BGRA8:
+    case GPU_SRGB8_ALPHA8:
+        return 4;
+    case GPU_RGB565:
+        return 2;
+    }
+    fprintf(stderr, "gpu_format_sizeof(): Unknown format 0x%x\n", format);
+    return 0;
+}
 
 gpu_frame gpu_frame_init(void *buf, uint32_t width, uint32_t height) {
+    return gpu_frame_init_target(buf, width, height, width * sizeof(gpu_color), GPU_RGBA8);
+}
+
+gpu_frame gpu_frame_init_target(void *buf, uint32_t width, uint32_t height,
+                                uint32_t pitch, uint32_t format) {
     return (gpu_frame){
         .buf = buf,
         .width = width,
         .height = height,
+        .pitch = pitch,
+        .format = format,
+        .bpp = gpu_format_sizeof(format),
     };
 }
 
+// returns color as it should be stored in the target, so raster loops can
+// write whole pixels without caring about the format
+uint32_t gpu_frame_pack(gpu_frame *frame, gpu_color color) {
+    uint32_t packed = 0;
+    switch (frame->format) {
+    case GPU_RGBA8:
+    case GPU_SRGB8_ALPHA8:
+        memcpy(&packed, &color, sizeof(color));
+        break;
+    case GPU_BGRA8: {
+        gpu_color bgra = {color.b, color.g, color.r, color.a};
+        memcpy(&packed, &bgra, sizeof(bgra));
+        break;
+    }
+    case GPU_RGB565:
+        packed = ((color.r >> 3) << 11) | ((color.g >> 2) << 5) | (color.b >> 3);
+        break;
+    }
+    return packed;
+}
+
+void gpu_frame_capture(gpu_frame *frame, gpu_capture *cap) {
+    frame->capture = cap;
+}
+
 void gpu_frame_clear(gpu_frame *frame, gpu_color color) {
-    for (int y = 0; y < frame->height; y++) {
-        for (int x = 0; x < frame->width; x++) {
-            gpu_color *pixel = &frame->buf[y * frame->width + x];
-            *pixel = color;
+    if (frame->capture) {
+        gpu_capture_clear(frame->capture, color);
+    }
+    uint32_t packed = gpu_frame_pack(frame, color);
+    if (frame->pitch == frame->width * frame->bpp) {
+        // no padding between rows, so the whole target is one fill
+        size_t len = (size_t)frame->width * frame->height;
+        if (frame->bpp == 2) {
+            gpu_kernels_get()->fill16((uint16_t *)frame->buf, packed, len);
+        } else {
+            gpu_kernels_get()->fill32((uint32_t *)frame->buf, packed, len);
         }
+        return;
+    }
+    for (int y = 0; y < frame->height; y++) {
+        gpu_span(frame, y, 0, frame->width, packed);
     }
 }
 
 void gpu_frame_queue(gpu_frame *frame, gpu_cmd *cmd) {
+    if (frame->capture) {
+        gpu_capture_cmd_write(frame->capture, cmd);
+    }
     tack_push(&frame->queue, cmd);
-    gpu_cmd_free(cmd);
+}
+
+void gpu_frame_execute(gpu_frame *frame, gpu_bundle *bundle, const mat4 *top) {
+    gpu_frame_queue(frame, gpu_cmd_new_bundle(bundle, top));
 }
 
 void gpu_frame_render(gpu_frame *frame) {
@@ -37,4 +103,18 @@ void gpu_frame_render(gpu_frame *frame) {
         gpu_cmd_draw(cmd, frame);
         gpu_cmd_free(cmd);
     }
+    // the queue keeps its capacity, so a reused frame stops allocating
+    tack_reset(&frame->queue);
+    if (frame->capture) {
+        gpu_capture_frame_end(frame->capture, frame);
+    }
+}
+
+// releases anything still queued, and the queue itself
+void gpu_frame_free(gpu_frame *frame) {
+    int len = tack_len(&frame->queue);
+    for (int i = 0; i < len; i++) {
+        gpu_cmd_free(tack_get(&frame->queue, i));
+    }
+    tack_clear(&frame->queue);
 }
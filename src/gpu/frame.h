@@ -4,8 +4,14 @@
 #include "types.h"
 
 gpu_frame gpu_frame_init(void *buf, uint32_t width, uint32_t height);
+gpu_frame gpu_frame_init_target(void *buf, uint32_t width, uint32_t height,
+                                uint32_t pitch, uint32_t format);
+uint32_t gpu_frame_pack(gpu_frame *frame, gpu_color color);
+void gpu_frame_capture(gpu_frame *frame, gpu_capture *cap);
 void gpu_frame_clear(gpu_frame *frame, gpu_color color);
 void gpu_frame_queue(gpu_frame *frame, gpu_cmd *cmd);
+void gpu_frame_execute(gpu_frame *frame, gpu_bundle *bundle, const mat4 *top);
 void gpu_frame_render(gpu_frame *frame);
+void gpu_frame_free(gpu_frame *frame);
 
 #endif
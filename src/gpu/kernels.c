@@ -0,0 +1,24 @@
+#include "cpu.h"
+#include "kernels.h"
+
+extern const gpu_kernels gpu_kernel_table_base;
+#ifdef GPU_KERNELS_X86
+extern const gpu_kernels gpu_kernel_table_sse41;
+extern const gpu_kernels gpu_kernel_table_avx2;
+extern const gpu_kernels gpu_kernel_table_avx512;
+#endif
+
+// picked by cpu_level(), so LIBGPU_CPU can force a lower variant
+const gpu_kernels *gpu_kernels_get() {
+#ifdef GPU_KERNELS_X86
+    static const gpu_kernels *tables[CPU_LEVELS] = {
+        [CPU_BASE] = &gpu_kernel_table_base,
+        [CPU_SSE41] = &gpu_kernel_table_sse41,
+        [CPU_AVX2] = &gpu_kernel_table_avx2,
+        [CPU_AVX512] = &gpu_kernel_table_avx512,
+    };
+    return tables[cpu_level()];
+#else
+    return &gpu_kernel_table_base;
+#endif
+}
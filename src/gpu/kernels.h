@@ -0,0 +1,38 @@
+#ifndef GPU_KERNELS_H
+#define GPU_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "light.h"
+#include "types.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GPU_KERNELS_X86
+#endif
+
+// the hot loops, built once per cpu_level() (see kernels_impl.h)
+typedef struct {
+    // transforms [begin, end) of in into the same range of out, which is
+    // already float and sized. mat has any position decode folded in.
+    void (*transform)(mat4 *mat, gpu_verts *out, gpu_verts *in, uint32_t begin, uint32_t end);
+    // blends palette by skin for each of [begin, end), with the same
+    // requirements on out as transform
+    void (*skin)(const gpu_skin *skin, const mat4 *palette, gpu_verts *out, gpu_verts *in,
+                 uint32_t begin, uint32_t end);
+    // lights [begin, end) of v in place, see gpu_light_setup
+    void (*light)(const gpu_light_setup *setup, gpu_verts *v, const gpu_pos *normal,
+                  uint32_t begin, uint32_t end);
+    void (*fill16)(uint16_t *dst, uint16_t value, size_t len);
+    void (*fill32)(uint32_t *dst, uint32_t value, size_t len);
+    // src-over of a premultiplied color, already packed: every byte of dst
+    // becomes the one of src plus itself times inverse_alpha / 255, rounded
+    void (*blend32)(uint32_t *dst, uint32_t src, uint32_t inverse_alpha, size_t len);
+    // decodes count 4x4 blocks of a GPU_BC1, GPU_BC3 or GPU_ETC1 texture,
+    // stored one after another, to 16 texels each in row order
+    void (*decode_blocks)(uint32_t format, const uint8_t *src, size_t count, gpu_color *dst);
+} gpu_kernels;
+
+const gpu_kernels *gpu_kernels_get();
+
+#endif
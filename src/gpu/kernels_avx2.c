@@ -0,0 +1,9 @@
+#include "kernels.h"
+
+#ifdef GPU_KERNELS_X86
+#ifndef __AVX2__
+#error "kernels_avx2.c must be built with -mavx2 -mfma"
+#endif
+#define GPU_KERNELS_SUFFIX avx2
+#include "kernels_impl.h"
+#endif
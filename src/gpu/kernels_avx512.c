@@ -0,0 +1,9 @@
+#include "kernels.h"
+
+#ifdef GPU_KERNELS_X86
+#ifndef __AVX512BW__
+#error "kernels_avx512.c must be built with -mavx512f -mavx512bw -mavx512vl"
+#endif
+#define GPU_KERNELS_SUFFIX avx512
+#include "kernels_impl.h"
+#endif
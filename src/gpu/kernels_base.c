@@ -0,0 +1,2 @@
+#define GPU_KERNELS_SUFFIX base
+#include "kernels_impl.h"
@@ -0,0 +1,604 @@
+// included once per instruction set level by the kernels_*.c files, each
+// of which is compiled with its own -m flags and defines GPU_KERNELS_SUFFIX.
+// the intrinsics picked below follow from those flags.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "enum.h"
+#include "kernels.h"
+#include "vectorial/simd8f.h"
+#include "verts.h"
+#include "verts_simd.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#define KERNEL_NAME_(name, suffix) gpu_kernel_##name##_##suffix
+#define KERNEL_NAME(name, suffix) KERNEL_NAME_(name, suffix)
+#define KERNEL(name) KERNEL_NAME(name, GPU_KERNELS_SUFFIX)
+
+// transforms positions eight at a time: the loaded positions are
+// transposed into x, y and z lanes and multiplied against broadcast matrix
+// elements, so there are no per-vertex shuffles and the divide by w is one
+// reciprocal (rcp plus a Newton step where the SIMD backend has one) per
+// eight vertices. the transposes work on two groups of four within each
+// simd8f, so vertex i shares a register with vertex i + 4. packed positions
+// are converted to float as they are loaded, their scale and offset having
+// been folded into mat.
+//
+// each load also picks up the component after the position (the color for
+// AOS, the next x for SOA, padding for packed positions). it is only
+// shuffled back to where it came from, which lets the stores be full width.
+// with a 12 byte output stride that store lands on the next x, so stores go
+// in vertex order and the last vertex is always left to the scalar loop,
+// which keeps anything from being written past len. for interleaved copies
+// out_v/in_v are set and the rest of each vertex is carried across in the
+// same pass.
+gpu_verts_inline void gpu_verts_transform_batch(mat4 *mat, float *out, const void *in,
+                                               size_t out_stride, size_t in_stride,
+                                               uint32_t pos_type, uint32_t len,
+                                               gpu_vert *out_v, const gpu_vert *in_v) {
+    #define out_at(i) ((float *)((uint8_t *)out + (size_t)(i) * out_stride))
+    #define in_at(i) ((const void *)((const uint8_t *)in + (size_t)(i) * in_stride))
+    #define load(i) simd8f_combine(gpu_verts_load4(in_at(i), pos_type), gpu_verts_load4(in_at(i + 4), pos_type))
+
+    float m[16];
+    mat4_save(mat, m);
+    simd8f c[4][4];
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            c[col][row] = simd8f_splat(m[col * 4 + row]);
+        }
+    }
+
+    uint32_t i = 0, spill = out_stride < 4 * sizeof(float);
+    for (; i + 8 + spill <= len; i += 8) {
+        simd8f px = load(i + 0), py = load(i + 1), pz = load(i + 2), pw = load(i + 3);
+        simd8f_transpose4(&px, &py, &pz, &pw);
+
+        simd8f x = simd8f_madd(c[0][0], px, simd8f_madd(c[1][0], py, simd8f_madd(c[2][0], pz, c[3][0])));
+        simd8f y = simd8f_madd(c[0][1], px, simd8f_madd(c[1][1], py, simd8f_madd(c[2][1], pz, c[3][1])));
+        simd8f z = simd8f_madd(c[0][2], px, simd8f_madd(c[1][2], py, simd8f_madd(c[2][2], pz, c[3][2])));
+        simd8f w = simd8f_madd(c[0][3], px, simd8f_madd(c[1][3], py, simd8f_madd(c[2][3], pz, c[3][3])));
+        simd8f rw = simd8f_reciprocal(w);
+
+        x = simd8f_mul(x, rw);
+        y = simd8f_mul(y, rw);
+        z = simd8f_mul(z, rw);
+        simd8f_transpose4(&x, &y, &z, &pw);
+        simd4f_ustore4(simd8f_get_low(x), out_at(i + 0));
+        simd4f_ustore4(simd8f_get_low(y), out_at(i + 1));
+        simd4f_ustore4(simd8f_get_low(z), out_at(i + 2));
+        simd4f_ustore4(simd8f_get_low(pw), out_at(i + 3));
+        simd4f_ustore4(simd8f_get_high(x), out_at(i + 4));
+        simd4f_ustore4(simd8f_get_high(y), out_at(i + 5));
+        simd4f_ustore4(simd8f_get_high(z), out_at(i + 6));
+        simd4f_ustore4(simd8f_get_high(pw), out_at(i + 7));
+        if (out_v) {
+            for (int j = 0; j < 8; j++) {
+                out_v[i + j].tex = in_v[i + j].tex;
+            }
+        }
+    }
+    for (; i < len; i++) {
+        if (out_v) {
+            out_v[i] = in_v[i];
+        }
+        float f[3];
+        gpu_verts_load3(in_at(i), pos_type, f);
+        mat4_mul_vec3(mat, out_at(i), f);
+    }
+
+    #undef out_at
+    #undef in_at
+    #undef load
+}
+
+// transforms [begin, end) of in into the same range of out, which is
+// already float and sized. mat already has any position decode folded in.
+static void KERNEL(transform)(mat4 *mat, gpu_verts *out, gpu_verts *in,
+                              uint32_t begin, uint32_t end) {
+    float *dst = (float *)gpu_verts_pos(out, begin);
+    const void *src = gpu_verts_pos(in, begin);
+    uint32_t len = end - begin;
+    // each case passes a constant stride and type so the kernel is
+    // specialized for it
+    if (in->layout == GPU_VERTS_AOS) {
+        if (out != in) {
+            gpu_verts_transform_batch(mat, dst, src, sizeof(gpu_vert), sizeof(gpu_vert),
+                                      GPU_FLOAT, len, out->v + begin, in->v + begin);
+        } else {
+            gpu_verts_transform_batch(mat, dst, src, sizeof(gpu_vert), sizeof(gpu_vert),
+                                      GPU_FLOAT, len, NULL, NULL);
+        }
+        return;
+    }
+    switch (in->pos_type) {
+    case GPU_SHORT:
+        gpu_verts_transform_batch(mat, dst, src, sizeof(gpu_pos), 4 * sizeof(int16_t),
+                                  GPU_SHORT, len, NULL, NULL);
+        break;
+    case GPU_UNSIGNED_SHORT:
+        gpu_verts_transform_batch(mat, dst, src, sizeof(gpu_pos), 4 * sizeof(uint16_t),
+                                  GPU_UNSIGNED_SHORT, len, NULL, NULL);
+        break;
+    default:
+        gpu_verts_transform_batch(mat, dst, src, sizeof(gpu_pos), sizeof(gpu_pos),
+                                  GPU_FLOAT, len, NULL, NULL);
+        break;
+    }
+    if (out != in) {
+        gpu_verts_unpack_attribs(out, in, begin, end);
+    }
+}
+
+// the four bone matrices are blended column by column and the position
+// goes through the result once. unused slots blend palette[0] with weight
+// 0, which is cheaper than branching on them.
+static void KERNEL(skin)(const gpu_skin *skin, const mat4 *palette, gpu_verts *out, gpu_verts *in,
+                         uint32_t begin, uint32_t end) {
+    // interleaved vertices are copied whole and then get their positions
+    // replaced, separate streams only need the other attributes
+    if (out != in && in->layout == GPU_VERTS_AOS) {
+        memcpy(out->v + begin, in->v + begin, sizeof(gpu_vert) * (end - begin));
+    } else if (out != in) {
+        gpu_verts_unpack_attribs(out, in, begin, end);
+    }
+    for (uint32_t i = begin; i < end; i++) {
+        const uint8_t *b = skin->index[i];
+        simd4f w = simd4f_uload4(skin->weight[i]);
+        simd4f w0 = simd4f_splat_x(w), w1 = simd4f_splat_y(w);
+        simd4f w2 = simd4f_splat_z(w), w3 = simd4f_splat_w(w);
+        const mat4 *p0 = &palette[b[0]], *p1 = &palette[b[1]];
+        const mat4 *p2 = &palette[b[2]], *p3 = &palette[b[3]];
+        simd4x4f m;
+        m.x = simd4f_madd(p3->x, w3, simd4f_madd(p2->x, w2, simd4f_madd(p1->x, w1, simd4f_mul(p0->x, w0))));
+        m.y = simd4f_madd(p3->y, w3, simd4f_madd(p2->y, w2, simd4f_madd(p1->y, w1, simd4f_mul(p0->y, w0))));
+        m.z = simd4f_madd(p3->z, w3, simd4f_madd(p2->z, w2, simd4f_madd(p1->z, w1, simd4f_mul(p0->z, w0))));
+        m.w = simd4f_madd(p3->w, w3, simd4f_madd(p2->w, w2, simd4f_madd(p1->w, w1, simd4f_mul(p0->w, w0))));
+        simd4f pos = gpu_verts_load4(gpu_verts_pos(in, i), in->pos_type), r;
+        simd4x4f_matrix_point3_mul(&m, &pos, &r);
+        simd4f_ustore3(r, (float *)gpu_verts_pos(out, i));
+    }
+}
+
+// rows of a 3x4 (or 3x3) matrix times x, y and z lanes
+#define GPU_LIGHT_ROW(m, r, x, y, z) \
+    simd4f_madd(simd4f_splat((m)[r][2]), z, \
+        simd4f_madd(simd4f_splat((m)[r][1]), y, simd4f_mul(simd4f_splat((m)[r][0]), x)))
+
+static inline simd4f gpu_light_dot(simd4f ax, simd4f ay, simd4f az, simd4f bx, simd4f by, simd4f bz) {
+    return simd4f_madd(az, bz, simd4f_madd(ay, by, simd4f_mul(ax, bx)));
+}
+
+// lights four vertices with one per lane. the lanes past n repeat the last
+// vertex and are dropped on store.
+gpu_verts_inline void gpu_light_batch(const gpu_light_setup *ls, gpu_verts *v, const gpu_pos *normal,
+                                      uint32_t i, uint32_t n) {
+    uint32_t idx[4];
+    for (uint32_t k = 0; k < 4; k++) {
+        idx[k] = i + (k < n ? k : n - 1);
+    }
+    // normals have a spare element, so every load can be 16 bytes
+    simd4x4f t = simd4x4f_create(simd4f_uload4(&normal[idx[0]].x), simd4f_uload4(&normal[idx[1]].x),
+                                 simd4f_uload4(&normal[idx[2]].x), simd4f_uload4(&normal[idx[3]].x));
+    simd4x4f_transpose_inplace(&t);
+    simd4f nx = GPU_LIGHT_ROW(ls->normal, 0, t.x, t.y, t.z);
+    simd4f ny = GPU_LIGHT_ROW(ls->normal, 1, t.x, t.y, t.z);
+    simd4f nz = GPU_LIGHT_ROW(ls->normal, 2, t.x, t.y, t.z);
+    simd4f inv = simd4f_rsqrt(simd4f_max(gpu_light_dot(nx, ny, nz, nx, ny, nz), simd4f_splat(1e-20f)));
+    nx = simd4f_mul(nx, inv);
+    ny = simd4f_mul(ny, inv);
+    nz = simd4f_mul(nz, inv);
+
+    simd4f px = simd4f_zero(), py = px, pz = px;
+    if (ls->local) {
+        simd4x4f p = simd4x4f_create(gpu_verts_load4(gpu_verts_pos(v, idx[0]), v->pos_type),
+                                     gpu_verts_load4(gpu_verts_pos(v, idx[1]), v->pos_type),
+                                     gpu_verts_load4(gpu_verts_pos(v, idx[2]), v->pos_type),
+                                     gpu_verts_load4(gpu_verts_pos(v, idx[3]), v->pos_type));
+        simd4x4f_transpose_inplace(&p);
+        px = simd4f_add(GPU_LIGHT_ROW(ls->modelview, 0, p.x, p.y, p.z), simd4f_splat(ls->modelview[0][3]));
+        py = simd4f_add(GPU_LIGHT_ROW(ls->modelview, 1, p.x, p.y, p.z), simd4f_splat(ls->modelview[1][3]));
+        pz = simd4f_add(GPU_LIGHT_ROW(ls->modelview, 2, p.x, p.y, p.z), simd4f_splat(ls->modelview[2][3]));
+    }
+
+    // ambient, diffuse and specular light are summed separately and only
+    // then multiplied by the material, which may vary per vertex
+    simd4f acc[3][3];
+    for (int c = 0; c < 3; c++) {
+        acc[0][c] = simd4f_splat(ls->ambient[c]);
+        acc[1][c] = acc[2][c] = simd4f_zero();
+    }
+    for (uint32_t l = 0; l < ls->count; l++) {
+        const gpu_light_eye *le = &ls->light[l];
+        simd4f lx, ly, lz, att = simd4f_splat(1.0f);
+        if (le->local) {
+            lx = simd4f_sub(simd4f_splat(le->position[0]), px);
+            ly = simd4f_sub(simd4f_splat(le->position[1]), py);
+            lz = simd4f_sub(simd4f_splat(le->position[2]), pz);
+            simd4f d2 = simd4f_max(gpu_light_dot(lx, ly, lz, lx, ly, lz), simd4f_splat(1e-20f));
+            simd4f r = simd4f_rsqrt(d2);
+            lx = simd4f_mul(lx, r);
+            ly = simd4f_mul(ly, r);
+            lz = simd4f_mul(lz, r);
+            if (le->attenuate) {
+                simd4f d = simd4f_mul(d2, r);
+                att = simd4f_div(att, simd4f_madd(simd4f_splat(le->quadratic), d2,
+                                        simd4f_madd(simd4f_splat(le->linear), d, simd4f_splat(le->constant))));
+            }
+        } else {
+            lx = simd4f_splat(le->position[0]);
+            ly = simd4f_splat(le->position[1]);
+            lz = simd4f_splat(le->position[2]);
+        }
+        simd4f ndotl = simd4f_max(gpu_light_dot(nx, ny, nz, lx, ly, lz), simd4f_zero());
+        simd4f diffuse = simd4f_mul(att, ndotl);
+        for (int c = 0; c < 3; c++) {
+            acc[0][c] = simd4f_madd(att, simd4f_splat(le->ambient[c]), acc[0][c]);
+            acc[1][c] = simd4f_madd(diffuse, simd4f_splat(le->diffuse[c]), acc[1][c]);
+        }
+        if (! le->specular_on) {
+            continue;
+        }
+        simd4f hx, hy, hz;
+        if (le->local) {
+            hx = lx;
+            hy = ly;
+            hz = simd4f_add(lz, simd4f_splat(1.0f));
+            simd4f r = simd4f_rsqrt(simd4f_max(gpu_light_dot(hx, hy, hz, hx, hy, hz), simd4f_splat(1e-20f)));
+            hx = simd4f_mul(hx, r);
+            hy = simd4f_mul(hy, r);
+            hz = simd4f_mul(hz, r);
+        } else {
+            hx = simd4f_splat(le->half[0]);
+            hy = simd4f_splat(le->half[1]);
+            hz = simd4f_splat(le->half[2]);
+        }
+        // the power comes from the shine table, a lane at a time. faces
+        // turned away from the light get no highlight.
+        float nl[4], nh[4], sp[4];
+        simd4f_ustore4(ndotl, nl);
+        simd4f_ustore4(simd4f_mul(simd4f_min(simd4f_max(gpu_light_dot(nx, ny, nz, hx, hy, hz),
+                                                        simd4f_zero()), simd4f_splat(1.0f)),
+                                  simd4f_splat(GPU_LIGHT_SHINE)), nh);
+        for (int k = 0; k < 4; k++) {
+            uint32_t j = (uint32_t)nh[k];
+            float f = nh[k] - j;
+            sp[k] = nl[k] > 0 ? ls->shine[j] + (ls->shine[j + 1] - ls->shine[j]) * f : 0;
+        }
+        simd4f specular = simd4f_mul(att, simd4f_uload4(sp));
+        for (int c = 0; c < 3; c++) {
+            acc[2][c] = simd4f_madd(specular, simd4f_splat(le->specular[c]), acc[2][c]);
+        }
+    }
+
+    float rgba[4][4];
+    float vc[4][4];
+    if (ls->color_material) {
+        for (int k = 0; k < 4; k++) {
+            gpu_color *col = gpu_verts_color(v, idx[k]);
+            vc[0][k] = col->r * (1.0f / 255);
+            vc[1][k] = col->g * (1.0f / 255);
+            vc[2][k] = col->b * (1.0f / 255);
+            vc[3][k] = col->a * (1.0f / 255);
+        }
+    }
+    for (int c = 0; c < 4; c++) {
+        simd4f out;
+        if (c == 3) {
+            out = ls->color_material ? simd4f_uload4(vc[3]) : simd4f_splat(ls->material_diffuse[3]);
+        } else {
+            simd4f ma, md;
+            if (ls->color_material) {
+                ma = md = simd4f_uload4(vc[c]);
+            } else {
+                ma = simd4f_splat(ls->material_ambient[c]);
+                md = simd4f_splat(ls->material_diffuse[c]);
+            }
+            out = simd4f_madd(acc[2][c], simd4f_splat(ls->material_specular[c]),
+                    simd4f_madd(acc[1][c], md,
+                      simd4f_madd(acc[0][c], ma, simd4f_splat(ls->emission[c]))));
+        }
+        out = simd4f_min(simd4f_max(out, simd4f_zero()), simd4f_splat(1.0f));
+        simd4f_ustore4(simd4f_madd(out, simd4f_splat(255.0f), simd4f_splat(0.5f)), rgba[c]);
+    }
+    for (uint32_t k = 0; k < n; k++) {
+        *gpu_verts_color(v, i + k) = (gpu_color){
+            (uint8_t)rgba[0][k], (uint8_t)rgba[1][k], (uint8_t)rgba[2][k], (uint8_t)rgba[3][k]};
+    }
+}
+
+static void KERNEL(light)(const gpu_light_setup *setup, gpu_verts *v, const gpu_pos *normal,
+                          uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i += 4) {
+        gpu_light_batch(setup, v, normal, i, end - i < 4 ? end - i : 4);
+    }
+}
+
+#undef GPU_LIGHT_ROW
+
+static void KERNEL(fill32)(uint32_t *dst, uint32_t value, size_t len) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    __m512i v = _mm512_set1_epi32(value);
+    for (; i + 16 <= len; i += 16) {
+        _mm512_storeu_si512(dst + i, v);
+    }
+    if (i < len) {
+        _mm512_mask_storeu_epi32(dst + i, (__mmask16)((1u << (len - i)) - 1), v);
+    }
+#else
+#if defined(__AVX__)
+    __m256i v = _mm256_set1_epi32(value);
+    for (; i + 8 <= len; i += 8) {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+#elif defined(__SSE2__)
+    __m128i v = _mm_set1_epi32(value);
+    for (; i + 4 <= len; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t v = vdupq_n_u32(value);
+    for (; i + 4 <= len; i += 4) {
+        vst1q_u32(dst + i, v);
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = value;
+    }
+#endif
+}
+
+static void KERNEL(blend32)(uint32_t *dst, uint32_t src, uint32_t inverse_alpha, size_t len) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i s = _mm256_set1_epi32(src), na = _mm256_set1_epi16(inverse_alpha);
+    __m256i zero = _mm256_setzero_si256(), half = _mm256_set1_epi16(128);
+    for (; i + 8 <= len; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), na), half);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), na), half);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), s));
+    }
+#elif defined(__SSE2__)
+    __m128i s = _mm_set1_epi32(src), na = _mm_set1_epi16(inverse_alpha);
+    __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16(128);
+    for (; i + 4 <= len; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), na), half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), na), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), s));
+    }
+#endif
+    for (; i < len; i++) {
+        uint8_t *d = (uint8_t *)(dst + i);
+        const uint8_t *s = (const uint8_t *)&src;
+        for (int k = 0; k < 4; k++) {
+            uint32_t x = d[k] * inverse_alpha + 128;
+            x = s[k] + ((x + (x >> 8)) >> 8);
+            d[k] = x > 255 ? 255 : x;
+        }
+    }
+}
+
+// 16 bit pixels are filled as pairs once dst is 4 byte aligned
+static void KERNEL(fill16)(uint16_t *dst, uint16_t value, size_t len) {
+    if (len && ((uintptr_t)dst & 2)) {
+        *dst++ = value;
+        len--;
+    }
+    KERNEL(fill32)((uint32_t *)dst, value | (uint32_t)value << 16, len / 2);
+    if (len & 1) {
+        dst[len - 1] = value;
+    }
+}
+
+// a 4x4 texel block reduced to palettes and indices. every format picks
+// each texel from four colors, ETC1 from one of two sets of them.
+typedef struct {
+    gpu_color palette[2][4];
+    // the 2 bit palette index of texel x is at bit 2x of index[y], and its
+    // palette is bit x of half[y]
+    uint8_t index[4], half[4];
+    // BC3 has an alpha per texel, in row order
+    bool has_alpha;
+    uint8_t alpha[16];
+} gpu_block;
+
+static inline gpu_color gpu_block_565(uint16_t v) {
+    uint32_t r = v >> 11, g = (v >> 5) & 0x3f, b = v & 0x1f;
+    return (gpu_color){(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+}
+
+// the color half of BC1 and BC3. BC1 blocks with color0 <= color1 have a
+// midpoint and transparent black instead of the two thirds.
+static inline void gpu_block_bc1(const uint8_t *src, gpu_block *block, bool punch) {
+    uint16_t c0 = src[0] | src[1] << 8, c1 = src[2] | src[3] << 8;
+    gpu_color *p = block->palette[0];
+    p[0] = gpu_block_565(c0);
+    p[1] = gpu_block_565(c1);
+    const uint8_t *a = &p[0].r, *b = &p[1].r;
+    uint8_t *c = &p[2].r, *d = &p[3].r;
+    if (punch && c0 <= c1) {
+        for (int k = 0; k < 3; k++) {
+            c[k] = (a[k] + b[k]) / 2;
+            d[k] = 0;
+        }
+        p[2].a = 255;
+        p[3].a = 0;
+    } else {
+        for (int k = 0; k < 3; k++) {
+            c[k] = (2 * a[k] + b[k]) / 3;
+            d[k] = (a[k] + 2 * b[k]) / 3;
+        }
+        p[2].a = p[3].a = 255;
+    }
+    memcpy(block->index, src + 4, 4);
+    memset(block->half, 0, 4);
+}
+
+// 8 alphas from two endpoints, or 6 plus 0 and 255 when a0 <= a1, picked
+// by 3 bit indices
+static inline void gpu_block_bc3_alpha(const uint8_t *src, gpu_block *block) {
+    uint32_t a0 = src[0], a1 = src[1];
+    uint8_t alpha[8] = {a0, a1};
+    if (a0 > a1) {
+        for (int i = 1; i < 7; i++) {
+            alpha[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+    } else {
+        for (int i = 1; i < 5; i++) {
+            alpha[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        }
+        alpha[6] = 0;
+        alpha[7] = 255;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++) {
+        bits |= (uint64_t)src[2 + i] << (8 * i);
+    }
+    for (int i = 0; i < 16; i++) {
+        block->alpha[i] = alpha[(bits >> (3 * i)) & 7];
+    }
+    block->has_alpha = true;
+}
+
+static inline uint8_t gpu_block_clamp(int32_t v) {
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// ETC1 blocks are two halves, side by side or (flipped) stacked, each
+// with a base color and one of eight modifier tables. texel indices are
+// stored column by column, high bits in one half word and low in the other.
+static inline void gpu_block_etc1(const uint8_t *src, gpu_block *block) {
+    static const int32_t modifier[8][2] = {
+        {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183},
+    };
+    uint32_t hi = (uint32_t)src[0] << 24 | src[1] << 16 | src[2] << 8 | src[3];
+    uint32_t lo = (uint32_t)src[4] << 24 | src[5] << 16 | src[6] << 8 | src[7];
+    bool diff = hi & 2, flip = hi & 1;
+    uint8_t base[2][3];
+    for (int k = 0; k < 3; k++) {
+        uint32_t shift = 27 - 8 * k;
+        if (diff) {
+            int32_t a = (hi >> shift) & 0x1f;
+            int32_t d = (int32_t)((hi >> (shift - 3)) & 7) << 29 >> 29;
+            int32_t b = (a + d) & 0x1f;
+            base[0][k] = (a << 3) | (a >> 2);
+            base[1][k] = (b << 3) | (b >> 2);
+        } else {
+            base[0][k] = ((hi >> (shift + 1)) & 0xf) * 17;
+            base[1][k] = ((hi >> (shift - 3)) & 0xf) * 17;
+        }
+    }
+    for (int h = 0; h < 2; h++) {
+        const int32_t *m = modifier[(hi >> (5 - 3 * h)) & 7];
+        int32_t step[4] = {m[0], m[1], -m[0], -m[1]};
+        for (int i = 0; i < 4; i++) {
+            uint8_t *c = &block->palette[h][i].r;
+            for (int k = 0; k < 3; k++) {
+                c[k] = gpu_block_clamp(base[h][k] + step[i]);
+            }
+            c[3] = 255;
+        }
+    }
+    memset(block->index, 0, 4);
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            uint32_t p = x * 4 + y;
+            uint32_t i = ((lo >> (16 + p)) & 1) << 1 | ((lo >> p) & 1);
+            block->index[y] |= i << (2 * x);
+        }
+    }
+    for (int y = 0; y < 4; y++) {
+        block->half[y] = flip ? (y < 2 ? 0 : 0xf) : 0xc;
+    }
+}
+
+// decodes count blocks of 8 (BC1, ETC1) or 16 (BC3) bytes, each to 16
+// texels in row order. the palettes and indices are worked out per block
+// and the texels are then picked with byte shuffles where there are any.
+static void KERNEL(decode_blocks)(uint32_t format, const uint8_t *src, size_t count, gpu_color *dst) {
+    size_t size = format == GPU_BC3 ? 16 : 8;
+    for (size_t n = 0; n < count; n++, src += size, dst += 16) {
+        gpu_block block;
+        block.has_alpha = false;
+        switch (format) {
+        case GPU_BC1:
+            gpu_block_bc1(src, &block, true);
+            break;
+        case GPU_BC3:
+            gpu_block_bc3_alpha(src, &block);
+            gpu_block_bc1(src + 8, &block, false);
+            break;
+        case GPU_ETC1:
+            gpu_block_etc1(src, &block);
+            break;
+        default:
+            memset(dst, 0, 16 * sizeof(gpu_color));
+            continue;
+        }
+#if defined(__SSSE3__)
+        // byte k of texel x is byte 4 * index + k of its palette
+        __m128i p0 = _mm_loadu_si128((const __m128i *)block.palette[0]);
+        // only ETC1 fills the second palette, BC1 and BC3 never select it
+        __m128i p1 = p0;
+        if (format == GPU_ETC1) {
+            p1 = _mm_loadu_si128((const __m128i *)block.palette[1]);
+        }
+        for (int y = 0; y < 4; y++) {
+            uint32_t row = block.index[y], half = block.half[y];
+            __m128i pick = _mm_set_epi32(
+                ((row >> 6) & 3) * 0x04040404 + 0x03020100, ((row >> 4) & 3) * 0x04040404 + 0x03020100,
+                ((row >> 2) & 3) * 0x04040404 + 0x03020100, (row & 3) * 0x04040404 + 0x03020100);
+            __m128i mask = _mm_set_epi32(-(half >> 3 & 1), -(half >> 2 & 1), -(half >> 1 & 1), -(half & 1));
+            __m128i texels = _mm_or_si128(_mm_andnot_si128(mask, _mm_shuffle_epi8(p0, pick)),
+                                          _mm_and_si128(mask, _mm_shuffle_epi8(p1, pick)));
+            if (block.has_alpha) {
+                // alpha x of the row goes to byte 3 of texel x
+                int32_t alpha;
+                memcpy(&alpha, block.alpha + 4 * y, 4);
+                __m128i a = _mm_cvtsi32_si128(alpha);
+                a = _mm_shuffle_epi8(a, _mm_set_epi32(0x03808080, 0x02808080, 0x01808080, 0x00808080));
+                texels = _mm_or_si128(_mm_and_si128(texels, _mm_set1_epi32(0x00ffffff)), a);
+            }
+            _mm_storeu_si128((__m128i *)(dst + 4 * y), texels);
+        }
+#else
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                gpu_color c = block.palette[(block.half[y] >> x) & 1][(block.index[y] >> (2 * x)) & 3];
+                if (block.has_alpha) {
+                    c.a = block.alpha[4 * y + x];
+                }
+                dst[4 * y + x] = c;
+            }
+        }
+#endif
+    }
+}
+
+const gpu_kernels KERNEL(table) = {
+    .transform = KERNEL(transform),
+    .skin = KERNEL(skin),
+    .light = KERNEL(light),
+    .fill16 = KERNEL(fill16),
+    .fill32 = KERNEL(fill32),
+    .blend32 = KERNEL(blend32),
+    .decode_blocks = KERNEL(decode_blocks),
+};
+
+#undef KERNEL_NAME_
+#undef KERNEL_NAME
+#undef KERNEL
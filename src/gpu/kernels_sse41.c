@@ -0,0 +1,9 @@
+#include "kernels.h"
+
+#ifdef GPU_KERNELS_X86
+#ifndef __SSE4_1__
+#error "kernels_sse41.c must be built with -msse4.1"
+#endif
+#define GPU_KERNELS_SUFFIX sse41
+#include "kernels_impl.h"
+#endif
@@ -0,0 +1,161 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "light.h"
+#include "pool.h"
+#include "verts.h"
+
+// lighting costs about as much per vertex as skinning
+#define GPU_LIGHT_CHUNK (8 * 1024)
+#define GPU_LIGHT_PARALLEL (2 * GPU_LIGHT_CHUNK)
+
+static inline void gpu_light_set4(float out[4], float r, float g, float b, float a) {
+    out[0] = r;
+    out[1] = g;
+    out[2] = b;
+    out[3] = a;
+}
+
+// the GL defaults: every light off, light 0 white and the others black,
+// all of them directional along +z
+void gpu_lighting_init(gpu_lighting *l) {
+    memset(l, 0, sizeof(gpu_lighting));
+    for (int i = 0; i < GPU_LIGHTS; i++) {
+        gpu_light *light = &l->light[i];
+        float c = i == 0 ? 1.0f : 0.0f;
+        gpu_light_set4(light->position, 0, 0, 1, 0);
+        gpu_light_set4(light->ambient, 0, 0, 0, 1);
+        gpu_light_set4(light->diffuse, c, c, c, 1);
+        gpu_light_set4(light->specular, c, c, c, 1);
+        light->constant = 1;
+    }
+    gpu_light_set4(l->material.ambient, 0.2f, 0.2f, 0.2f, 1);
+    gpu_light_set4(l->material.diffuse, 0.8f, 0.8f, 0.8f, 1);
+    gpu_light_set4(l->material.specular, 0, 0, 0, 1);
+    gpu_light_set4(l->material.emission, 0, 0, 0, 1);
+    gpu_light_set4(l->ambient, 0.2f, 0.2f, 0.2f, 1);
+}
+
+static void gpu_light_normalize(float v[3]) {
+    float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 0) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    }
+}
+
+static void gpu_light_setup_init(gpu_light_setup *ls, gpu_lighting *l, const mat4 *modelview, gpu_verts *v) {
+    memset(ls, 0, sizeof(gpu_light_setup));
+    // normals use the inverse transpose of the original matrix, positions
+    // the one with the decode of packed positions folded in
+    mat4 mv = *modelview, inv;
+    float m[16], n[16];
+    simd4x4f_inverse(&mv, &inv);
+    mat4_save(&inv, n);
+    if (v->pos_type != GPU_FLOAT) {
+        gpu_verts_decode_mat(v, modelview, &mv);
+    }
+    mat4_save(&mv, m);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            ls->modelview[r][c] = m[c * 4 + r];
+        }
+        // transposing the column major inverse makes it row major
+        for (int c = 0; c < 3; c++) {
+            ls->normal[r][c] = n[r * 4 + c];
+        }
+    }
+
+    const gpu_material *mat = &l->material;
+    for (int c = 0; c < 3; c++) {
+        ls->ambient[c] = l->ambient[c];
+        ls->emission[c] = mat->emission[c];
+        ls->material_ambient[c] = mat->ambient[c];
+        ls->material_diffuse[c] = mat->diffuse[c];
+        ls->material_specular[c] = mat->specular[c];
+    }
+    ls->material_diffuse[3] = mat->diffuse[3];
+    // one extra entry so interpolating at exactly 1 stays in bounds
+    for (int i = 0; i <= GPU_LIGHT_SHINE + 1; i++) {
+        ls->shine[i] = powf(fminf((float)i / GPU_LIGHT_SHINE, 1.0f), mat->shininess);
+    }
+    ls->color_material = l->color_material;
+
+    bool specular = mat->specular[0] > 0 || mat->specular[1] > 0 || mat->specular[2] > 0;
+    for (int i = 0; i < GPU_LIGHTS; i++) {
+        const gpu_light *light = &l->light[i];
+        if (! light->enabled) {
+            continue;
+        }
+        gpu_light_eye *le = &ls->light[ls->count++];
+        memcpy(le->position, light->position, sizeof(le->position));
+        memcpy(le->ambient, light->ambient, sizeof(le->ambient));
+        memcpy(le->diffuse, light->diffuse, sizeof(le->diffuse));
+        memcpy(le->specular, light->specular, sizeof(le->specular));
+        le->local = light->position[3] != 0;
+        le->specular_on = specular && (light->specular[0] > 0 || light->specular[1] > 0 || light->specular[2] > 0);
+        if (le->local) {
+            for (int c = 0; c < 3; c++) {
+                le->position[c] /= light->position[3];
+            }
+            le->constant = light->constant;
+            le->linear = light->linear;
+            le->quadratic = light->quadratic;
+            le->attenuate = light->constant != 1 || light->linear != 0 || light->quadratic != 0;
+            ls->local = true;
+        } else {
+            // with the viewer at infinity the half vector is the same for
+            // every vertex
+            gpu_light_normalize(le->position);
+            le->half[0] = le->position[0];
+            le->half[1] = le->position[1];
+            le->half[2] = le->position[2] + 1;
+            gpu_light_normalize(le->half);
+        }
+    }
+}
+
+typedef struct {
+    const gpu_kernels *kernels;
+    const gpu_light_setup *setup;
+    gpu_verts *v;
+    const gpu_pos *normal;
+} gpu_light_job;
+
+static void gpu_light_chunk(void *ctx, uint32_t index) {
+    gpu_light_job *job = ctx;
+    uint32_t begin = index * GPU_LIGHT_CHUNK;
+    uint32_t end = begin + GPU_LIGHT_CHUNK < job->v->len ? begin + GPU_LIGHT_CHUNK : job->v->len;
+    job->kernels->light(job->setup, job->v, job->normal, begin, end);
+}
+
+// computes GL 1.x per-vertex lighting for in, which needs normals, and
+// stores it as the vertex color. modelview takes positions and normals to
+// eye space, where the lights are. with out NULL or distinct from in, the
+// vertices are first unpacked into out (see gpu_verts_unpack()), otherwise
+// in is lit in place.
+gpu_verts *gpu_light_apply(gpu_lighting *l, const mat4 *modelview, gpu_verts *out, gpu_verts *in) {
+    if (in->normal == NULL) {
+        fprintf(stderr, "gpu_light_apply(): Vertices have no normals\n");
+        return NULL;
+    }
+    if (out != in) {
+        out = gpu_verts_unpack(out, in);
+        if (out == NULL) {
+            return NULL;
+        }
+    }
+    gpu_light_setup setup;
+    gpu_light_setup_init(&setup, l, modelview, out);
+    gpu_light_job job = {gpu_kernels_get(), &setup, out, in->normal};
+    if (out->len < GPU_LIGHT_PARALLEL) {
+        job.kernels->light(&setup, out, in->normal, 0, out->len);
+    } else {
+        pool_run(pool_default(), gpu_light_chunk, &job,
+                 (out->len + GPU_LIGHT_CHUNK - 1) / GPU_LIGHT_CHUNK);
+    }
+    return out;
+}
@@ -0,0 +1,39 @@
+#ifndef GPU_LIGHT_H
+#define GPU_LIGHT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+// one enabled light, ready for the kernel. directional lights have a unit
+// direction in position and their constant half vector in half.
+typedef struct {
+    float position[3], half[3];
+    float ambient[3], diffuse[3], specular[3];
+    float constant, linear, quadratic;
+    bool local, attenuate, specular_on;
+} gpu_light_eye;
+
+// n.h ^ shininess is looked up rather than computed, interpolating
+// between this many steps over [0, 1]
+#define GPU_LIGHT_SHINE 256
+
+// gpu_lighting resolved against one modelview. modelview has any packed
+// position decode folded in, normal is the inverse transpose of the
+// original's upper 3x3. both are row major.
+typedef struct {
+    float modelview[3][4], normal[3][3];
+    uint32_t count;
+    gpu_light_eye light[GPU_LIGHTS];
+    float ambient[3], emission[3];
+    float material_ambient[3], material_diffuse[4], material_specular[3];
+    float shine[GPU_LIGHT_SHINE + 2];
+    // eye space positions are only needed by local lights
+    bool local, color_material;
+} gpu_light_setup;
+
+void gpu_lighting_init(gpu_lighting *l);
+gpu_verts *gpu_light_apply(gpu_lighting *l, const mat4 *modelview, gpu_verts *out, gpu_verts *in);
+
+#endif
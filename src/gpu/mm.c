@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -8,3 +10,16 @@ void *memdup(void *src, size_t size) {
     memcpy(dst, src, size);
     return dst;
 }
+
+// align must be a power of two multiple of sizeof(void *)
+void *memalign_alloc(size_t align, size_t size) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, align, size ? size : align) != 0) {
+        return NULL;
+    }
+    return ptr;
+}
+
+void memalign_free(void *ptr) {
+    free(ptr);
+}
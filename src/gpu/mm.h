@@ -4,5 +4,7 @@
 #include <stdlib.h>
 
 void *memdup(void *src, size_t size);
+void *memalign_alloc(size_t align, size_t size);
+void memalign_free(void *ptr);
 
 #endif
@@ -1,9 +1,16 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "enum.h"
 #include "frame.h"
+#include "kernels.h"
+#include "raster.h"
+#include "srgb.h"
+#include "tex.h"
+#include "verts.h"
 
 #ifndef MIN
 #define MIN(a, b) (((a) < (b) ? (a) : (b)))
@@ -23,27 +30,302 @@
 
 #define SWAP(a, b) do { tmp = (a); (a) = (b); (b) = (tmp); } while (0);
 
-gpu_color white = {0xFF, 0xFF, 0xFF, 0xFF};
-
 bool is_backward(gpu_verts *v, int index) {
-    gpu_pos *a = &v->v[index+0].pos;
-    gpu_pos *b = &v->v[index+1].pos;
-    gpu_pos *c = &v->v[index+2].pos;
+    gpu_pos *a = gpu_verts_pos(v, index+0);
+    gpu_pos *b = gpu_verts_pos(v, index+1);
+    gpu_pos *c = gpu_verts_pos(v, index+2);
     return ((b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x)) <= 0;
 }
 
-static inline gpu_color *gpu_pixel_at(gpu_frame *frame, int x, int y) {
+static inline uint8_t *gpu_pixel_at(gpu_frame *frame, int x, int y) {
     if (x < 0 || x >= frame->width || y < 0 || y >= frame->height) return NULL;
-    return &(frame->buf[x + y * frame->width]);
+    return frame->buf + y * frame->pitch + x * frame->bpp;
 }
 
-void gpu_pixel(gpu_frame *frame, int x, int y) {
-    gpu_color *pixel = gpu_pixel_at(frame, x, y);
+void gpu_pixel(gpu_frame *frame, int x, int y, uint32_t color) {
+    uint8_t *pixel = gpu_pixel_at(frame, x, y);
     if (pixel == NULL) return;
-    *pixel = white;
+    if (frame->bpp == 2) {
+        *(uint16_t *)pixel = color;
+    } else {
+        *(uint32_t *)pixel = color;
+    }
+}
+
+// fills [x1, x2) on row y with an already packed color
+void gpu_span(gpu_frame *frame, int y, int x1, int x2, uint32_t color) {
+    x1 = MAX(x1, 0);
+    x2 = MIN(x2, (int)frame->width);
+    if (x1 >= x2 || y < 0 || y >= frame->height) return;
+    uint8_t *row = gpu_pixel_at(frame, x1, y);
+    int len = x2 - x1;
+    if (frame->bpp == 2) {
+        gpu_kernels_get()->fill16((uint16_t *)row, color, len);
+    } else {
+        gpu_kernels_get()->fill32((uint32_t *)row, color, len);
+    }
+}
+
+// 565 targets blend in bytes, widened by repeating the top bits
+static inline gpu_color gpu_unpack565(uint16_t v) {
+    uint32_t r = v >> 11, g = (v >> 5) & 0x3f, b = v & 0x1f;
+    return (gpu_color){(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+}
+
+// byte offsets of red, green and blue in a 32 bit target pixel
+static inline const uint8_t *gpu_rgb_order(gpu_frame *frame) {
+    static const uint8_t rgba[3] = {0, 1, 2}, bgra[3] = {2, 1, 0};
+    return frame->format == GPU_BGRA8 ? bgra : rgba;
+}
+
+// blends color over [x1, x2) on row y by its alpha. sRGB targets blend in
+// linear light, through the 12 bit tables rather than pow().
+void gpu_span_blend(gpu_frame *frame, int y, int x1, int x2, gpu_color color) {
+    x1 = MAX(x1, 0);
+    x2 = MIN(x2, (int)frame->width);
+    if (x1 >= x2 || y < 0 || y >= frame->height || color.a == 0) return;
+    if (color.a == 255) {
+        gpu_span(frame, y, x1, x2, gpu_frame_pack(frame, color));
+        return;
+    }
+    uint8_t *p = gpu_pixel_at(frame, x1, y);
+    int len = x2 - x1;
+    uint32_t a = color.a, na = 255 - a;
+    uint32_t src[3] = {color.r * a, color.g * a, color.b * a};
+    if (frame->bpp == 2) {
+        for (; len > 0; len--, p += 2) {
+            gpu_color d = gpu_unpack565(*(uint16_t *)p);
+            d.r = (src[0] + d.r * na + 127) / 255;
+            d.g = (src[1] + d.g * na + 127) / 255;
+            d.b = (src[2] + d.b * na + 127) / 255;
+            *(uint16_t *)p = gpu_frame_pack(frame, d);
+        }
+        return;
+    }
+    const uint8_t *o = gpu_rgb_order(frame);
+    if (frame->format == GPU_SRGB8_ALPHA8) {
+        const srgb_tables_t *tables = srgb_tables();
+        for (int c = 0; c < 3; c++) {
+            src[c] = tables->to_linear12[(&color.r)[c]] * a;
+        }
+        for (; len > 0; len--, p += 4) {
+            for (int c = 0; c < 3; c++) {
+                p[c] = tables->from_linear12[(src[c] + tables->to_linear12[p[c]] * na + 127) / 255];
+            }
+            p[3] = a + (p[3] * na + 127) / 255;
+        }
+        return;
+    }
+    for (; len > 0; len--, p += 4) {
+        for (int c = 0; c < 3; c++) {
+            p[o[c]] = (src[c] + p[o[c]] * na + 127) / 255;
+        }
+        p[3] = a + (p[3] * na + 127) / 255;
+    }
+}
+
+// blends a premultiplied color over [x1, x2) on row y. linear 32 bit
+// targets are one blend32 pass. sRGB targets go through the tables like
+// gpu_span_blend(), so color should be multiplied in linear light.
+void gpu_span_blend_premultiplied(gpu_frame *frame, int y, int x1, int x2, gpu_color color) {
+    x1 = MAX(x1, 0);
+    x2 = MIN(x2, (int)frame->width);
+    if (x1 >= x2 || y < 0 || y >= frame->height) return;
+    if (color.a == 255) {
+        gpu_span(frame, y, x1, x2, gpu_frame_pack(frame, color));
+        return;
+    }
+    uint8_t *p = gpu_pixel_at(frame, x1, y);
+    int len = x2 - x1;
+    uint32_t na = 255 - color.a;
+    if (frame->bpp == 2) {
+        for (; len > 0; len--, p += 2) {
+            gpu_color d = gpu_unpack565(*(uint16_t *)p);
+            d.r = MIN(color.r + (d.r * na + 127) / 255, 255);
+            d.g = MIN(color.g + (d.g * na + 127) / 255, 255);
+            d.b = MIN(color.b + (d.b * na + 127) / 255, 255);
+            *(uint16_t *)p = gpu_frame_pack(frame, d);
+        }
+        return;
+    }
+    if (frame->format == GPU_SRGB8_ALPHA8) {
+        const srgb_tables_t *tables = srgb_tables();
+        uint32_t src[3];
+        for (int c = 0; c < 3; c++) {
+            src[c] = tables->to_linear12[(&color.r)[c]];
+        }
+        for (; len > 0; len--, p += 4) {
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = src[c] + (tables->to_linear12[p[c]] * na + 127) / 255;
+                p[c] = tables->from_linear12[MIN(v, SRGB_LINEAR_MAX)];
+            }
+            p[3] = MIN(color.a + (p[3] * na + 127) / 255, 255);
+        }
+        return;
+    }
+    gpu_kernels_get()->blend32((uint32_t *)p, gpu_frame_pack(frame, color), na, len);
+}
+
+// a [0, 1] float as a rounded byte
+static inline uint8_t gpu_unit8(float v) {
+    return v >= 1 ? 255 : v <= 0 ? 0 : (uint8_t)(v * 255 + 0.5f);
+}
+
+// draws tex over [x1, x2) on row y, the i-th pixel from x1 sampled at
+// (s + i * ds, t + i * dt) and blended by the texel alpha. sRGB targets
+// blend in linear light. premultiplied textures skip the multiply.
+void gpu_span_tex(gpu_frame *frame, int y, int x1, int x2, const gpu_tex *tex,
+                  float s, float t, float ds, float dt) {
+    if (x1 < 0) {
+        s -= x1 * ds;
+        t -= x1 * dt;
+        x1 = 0;
+    }
+    x2 = MIN(x2, (int)frame->width);
+    if (x1 >= x2 || y < 0 || y >= frame->height) return;
+    uint8_t *p = gpu_pixel_at(frame, x1, y);
+    const srgb_tables_t *tables = srgb_tables();
+    const uint8_t *o = gpu_rgb_order(frame);
+    bool premultiplied = tex->flags & GPU_TEX_PREMULTIPLIED;
+    for (int x = x1; x < x2; x++, s += ds, t += dt, p += frame->bpp) {
+        float c[4];
+        gpu_tex_sample(tex, s, t, c);
+        float a = c[3], na = 1 - a;
+        if (! premultiplied) {
+            c[0] *= a;
+            c[1] *= a;
+            c[2] *= a;
+        }
+        if (frame->bpp == 2) {
+            gpu_color d = gpu_unpack565(*(uint16_t *)p);
+            d.r = gpu_unit8(c[0] + d.r * (na / 255));
+            d.g = gpu_unit8(c[1] + d.g * (na / 255));
+            d.b = gpu_unit8(c[2] + d.b * (na / 255));
+            *(uint16_t *)p = gpu_frame_pack(frame, d);
+            continue;
+        }
+        if (frame->format == GPU_SRGB8_ALPHA8) {
+            for (int k = 0; k < 3; k++) {
+                p[k] = srgb_encode(tables, c[k] + tables->to_linear[p[k]] * na);
+            }
+        } else {
+            for (int k = 0; k < 3; k++) {
+                p[o[k]] = gpu_unit8(c[k] + p[o[k]] * (na / 255));
+            }
+        }
+        p[3] = gpu_unit8(a + p[3] * (na / 255));
+    }
 }
 
-void gpu_line(gpu_frame *frame, gpu_pos *a, gpu_pos *b) {
+// up to four values interpolated over a triangle, as planes over the
+// screen: c + dx * (x - x0) + dy * (y - y0) for each. used for vertex
+// colors times the command color, and for texture coordinates.
+typedef struct {
+    float c[4], dx[4], dy[4];
+    float x0, y0;
+} gpu_shade;
+
+// sets up the planes through the values c of the three vertices of
+// triangle index. returns false if the triangle has no area.
+static bool gpu_shade_planes(gpu_shade *s, gpu_verts *v, int index, float c[3][4]) {
+    gpu_pos *p0 = gpu_verts_pos(v, index), *p1 = gpu_verts_pos(v, index + 1), *p2 = gpu_verts_pos(v, index + 2);
+    float ex1 = p1->x - p0->x, ey1 = p1->y - p0->y, ex2 = p2->x - p0->x, ey2 = p2->y - p0->y;
+    float area = ex1 * ey2 - ex2 * ey1;
+    if (area == 0) {
+        return false;
+    }
+    for (int k = 0; k < 4; k++) {
+        float d1 = c[1][k] - c[0][k], d2 = c[2][k] - c[0][k];
+        s->c[k] = c[0][k];
+        s->dx[k] = (d1 * ey2 - d2 * ey1) / area;
+        s->dy[k] = (d2 * ex1 - d1 * ex2) / area;
+    }
+    s->x0 = p0->x;
+    s->y0 = p0->y;
+    return true;
+}
+
+// value k of s at pixel (x, y)
+static inline float gpu_shade_at(const gpu_shade *s, int k, int x, int y) {
+    return s->c[k] + s->dx[k] * (x - s->x0) + s->dy[k] * (y - s->y0);
+}
+
+// what a filled triangle puts in its spans. tex, if set, wins over shade,
+// which wins over the flat color. blend is 0 (none), GPU_SRC_ALPHA or
+// GPU_ONE for premultiplied colors, and applies to colors; textured spans
+// always blend by texel alpha.
+typedef struct {
+    uint32_t packed;
+    gpu_color color;
+    uint32_t blend;
+    const gpu_shade *shade;
+    const gpu_tex *tex;
+    const gpu_shade *coords;
+} gpu_fill;
+
+// modulates the color of vertex i by tint
+static inline void gpu_shade_vertex(gpu_verts *v, int i, gpu_color tint, float out[4]) {
+    const gpu_color *c = gpu_verts_color(v, i);
+    out[0] = c->r * tint.r * (1 / 255.0f);
+    out[1] = c->g * tint.g * (1 / 255.0f);
+    out[2] = c->b * tint.b * (1 / 255.0f);
+    out[3] = c->a * tint.a * (1 / 255.0f);
+}
+
+static inline gpu_color gpu_shade_color(const float c[4]) {
+    return (gpu_color){gpu_unit8(c[0] / 255), gpu_unit8(c[1] / 255),
+                       gpu_unit8(c[2] / 255), gpu_unit8(c[3] / 255)};
+}
+
+// sets up the color planes of triangle index. returns false if it is a
+// single color, which is then stored in flat.
+static bool gpu_shade_init(gpu_shade *s, gpu_verts *v, int index, gpu_color tint, gpu_color *flat) {
+    float c[3][4];
+    for (int k = 0; k < 3; k++) {
+        gpu_shade_vertex(v, index + k, tint, c[k]);
+    }
+    gpu_color a = gpu_shade_color(c[0]), b = gpu_shade_color(c[1]), d = gpu_shade_color(c[2]);
+    if ((! memcmp(&a, &b, sizeof(a)) && ! memcmp(&a, &d, sizeof(a))) ||
+        ! gpu_shade_planes(s, v, index, c)) {
+        *flat = a;
+        return false;
+    }
+    return true;
+}
+
+// fills [x1, x2) on row y with the interpolated colors of shade, blended
+// pixel by pixel if blend is set
+static void gpu_span_shade(gpu_frame *frame, int y, int x1, int x2, const gpu_shade *s, uint32_t blend) {
+    x1 = MAX(x1, 0);
+    x2 = MIN(x2, (int)frame->width);
+    if (x1 >= x2 || y < 0 || y >= frame->height) return;
+    float c[4];
+    for (int k = 0; k < 4; k++) {
+        c[k] = gpu_shade_at(s, k, x1, y);
+    }
+    uint8_t *p = gpu_pixel_at(frame, x1, y);
+    const uint8_t *o = gpu_rgb_order(frame);
+    for (int x = x1; x < x2; x++, p += frame->bpp) {
+        gpu_color color = gpu_shade_color(c);
+        if (blend == GPU_SRC_ALPHA) {
+            gpu_span_blend(frame, y, x, x + 1, color);
+        } else if (blend == GPU_ONE) {
+            gpu_span_blend_premultiplied(frame, y, x, x + 1, color);
+        } else if (frame->bpp == 2) {
+            *(uint16_t *)p = gpu_frame_pack(frame, color);
+        } else {
+            p[o[0]] = color.r;
+            p[o[1]] = color.g;
+            p[o[2]] = color.b;
+            p[3] = color.a;
+        }
+        for (int k = 0; k < 4; k++) {
+            c[k] += s->dx[k];
+        }
+    }
+}
+
+void gpu_line(gpu_frame *frame, gpu_pos *a, gpu_pos *b, uint32_t color) {
     float x1, y1, x2, y2;
     float tmp;
     x1 = a->x, y1 = a->y;
@@ -63,15 +345,31 @@ void gpu_line(gpu_frame *frame, gpu_pos *a, gpu_pos *b) {
     for (float x = MAX(x1, 0); x < MIN(x2, max); x++) {
         float y = slope * (x - x1) + y1;
         if (steep) {
-            gpu_pixel(frame, y, x);
+            gpu_pixel(frame, y, x, color);
         } else {
-            gpu_pixel(frame, x, y);
+            gpu_pixel(frame, x, y, color);
         }
     }
 }
 
-void gpu_triangle_fill(gpu_frame *frame, gpu_verts *v, int index) {
-    gpu_pos *v1 = &v->v[index+0].pos, *v2 = &v->v[index+1].pos, *v3 = &v->v[index+2].pos;
+static inline void gpu_triangle_span(gpu_frame *frame, int y, int x1, int x2, const gpu_fill *fill) {
+    if (fill->tex) {
+        const gpu_shade *st = fill->coords;
+        gpu_span_tex(frame, y, x1, x2, fill->tex, gpu_shade_at(st, 0, x1, y), gpu_shade_at(st, 1, x1, y),
+                     st->dx[0], st->dx[1]);
+    } else if (fill->shade) {
+        gpu_span_shade(frame, y, x1, x2, fill->shade, fill->blend);
+    } else if (fill->blend == GPU_SRC_ALPHA) {
+        gpu_span_blend(frame, y, x1, x2, fill->color);
+    } else if (fill->blend == GPU_ONE) {
+        gpu_span_blend_premultiplied(frame, y, x1, x2, fill->color);
+    } else {
+        gpu_span(frame, y, x1, x2, fill->packed);
+    }
+}
+
+static void gpu_triangle_fill(gpu_frame *frame, gpu_verts *v, int index, const gpu_fill *fill) {
+    gpu_pos *v1 = gpu_verts_pos(v, index+0), *v2 = gpu_verts_pos(v, index+1), *v3 = gpu_verts_pos(v, index+2);
     gpu_pos *tmp;
     // sort vertices
     if (v2->y < v1->y) {
@@ -118,10 +416,7 @@ void gpu_triangle_fill(gpu_frame *frame, gpu_verts *v, int index) {
         for (int y = lmid->y; y < top->y; y += 1) {
             float tlx = MAX(0, MIN(lx, frame->width));
             float trx = MAX(0, MIN(rx, frame->width));
-            gpu_color *pixel = gpu_pixel_at(frame, tlx, y);
-            for (int x = tlx; x < trx; x++) {
-                *pixel++ = white;
-            }
+            gpu_triangle_span(frame, y, tlx, ceilf(trx), fill);
             lx += ldx;
             rx += rdx;
         }
@@ -143,26 +438,51 @@ void gpu_triangle_fill(gpu_frame *frame, gpu_verts *v, int index) {
         for (int y = bot->y; y < lmid->y; y += 1) {
             float tlx = MAX(0, MIN(lx, frame->width));
             float trx = MAX(0, MIN(rx, frame->width));
-            gpu_color *pixel = gpu_pixel_at(frame, tlx, y);
-            for (int x = tlx; x < trx; x++) {
-                *pixel++ = white;
-            }
+            gpu_triangle_span(frame, y, tlx, ceilf(trx), fill);
             lx += ldx;
             rx += rdx;
         }
     }
 }
 
-void gpu_triangle(gpu_frame *frame, gpu_verts *verts, int index, bool wire) {
+// draws triangle index of verts with the state of cmd. filled triangles
+// are textured if cmd->tex is set, or else take their vertex colors times
+// tint, Gouraud shaded unless all three come out the same, and blended by
+// cmd->blend. wireframe edges are opaque and take the color of the vertex
+// they start at.
+void gpu_triangle(gpu_frame *frame, gpu_verts *verts, int index, const gpu_cmd *cmd, gpu_color tint) {
     if (is_backward(verts, index)) {
         return;
     }
-    if (wire) {
+    if (cmd->wireframe) {
         for (int i = index; i < index + 3; i++) {
             int next = index + (i + 1) % 3;
-            gpu_line(frame, &verts->v[i].pos, &verts->v[next].pos);
+            float c[4];
+            gpu_shade_vertex(verts, i, tint, c);
+            gpu_line(frame, gpu_verts_pos(verts, i), gpu_verts_pos(verts, next),
+                     gpu_frame_pack(frame, gpu_shade_color(c)));
+        }
+        return;
+    }
+    gpu_fill fill = {.blend = cmd->blend};
+    gpu_shade shade, coords;
+    if (cmd->tex) {
+        // texture coordinates are interpolated in screen space
+        float st[3][4] = {{0}};
+        for (int k = 0; k < 3; k++) {
+            const gpu_tex_coord *tc = gpu_verts_tex(verts, index + k);
+            st[k][0] = tc->s;
+            st[k][1] = tc->t;
+        }
+        if (! gpu_shade_planes(&coords, verts, index, st)) {
+            return;
         }
+        fill.tex = cmd->tex;
+        fill.coords = &coords;
+    } else if (gpu_shade_init(&shade, verts, index, tint, &fill.color)) {
+        fill.shade = &shade;
     } else {
-        gpu_triangle_fill(frame, verts, index);
+        fill.packed = gpu_frame_pack(frame, fill.color);
     }
+    gpu_triangle_fill(frame, verts, index, &fill);
 }
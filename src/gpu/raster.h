@@ -4,6 +4,13 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-extern void gpu_triangle(gpu_frame *frame, gpu_verts *verts, int index, bool fill);
+#include "types.h"
+
+extern void gpu_span(gpu_frame *frame, int y, int x1, int x2, uint32_t color);
+extern void gpu_span_blend(gpu_frame *frame, int y, int x1, int x2, gpu_color color);
+extern void gpu_span_blend_premultiplied(gpu_frame *frame, int y, int x1, int x2, gpu_color color);
+extern void gpu_span_tex(gpu_frame *frame, int y, int x1, int x2, const gpu_tex *tex,
+                         float s, float t, float ds, float dt);
+extern void gpu_triangle(gpu_frame *frame, gpu_verts *verts, int index, const gpu_cmd *cmd, gpu_color tint);
 
 #endif
@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "cmd.h"
+#include "frame.h"
+#include "verts.h"
+
+#define record_next(r) \
+    ((const gpu_capture_record *)((const uint8_t *)((r) + 1) + (r)->size))
+
+// whether a record's payload is exactly what its tag says it holds, so
+// replaying never reads past it. unknown tags are rejected rather than
+// skipped, a newer writer bumps the version instead
+static bool gpu_replay_record_valid(const gpu_capture_record *r) {
+    uint64_t size;
+    switch (r->tag) {
+    case GPU_CAPTURE_CLEAR:
+        size = sizeof(gpu_color);
+        break;
+    case GPU_CAPTURE_FRAME:
+        size = sizeof(gpu_capture_frame);
+        break;
+    case GPU_CAPTURE_CMD: {
+        const gpu_capture_cmd *head = (const gpu_capture_cmd *)(r + 1);
+        if (r->size < sizeof(*head)) return false;
+        size = sizeof(*head) + (uint64_t)sizeof(gpu_vert) * head->len +
+               (uint64_t)sizeof(mat4) * head->instances;
+        if (head->colors) {
+            size += (uint64_t)sizeof(gpu_color) * head->instances;
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    return r->size == size + GPU_CAPTURE_PADDING(size);
+}
+
+// builds the command for a CMD record, with vertices and instance data
+// used in place. the mapping is never written to
+static gpu_cmd *gpu_replay_cmd_new(const gpu_capture_record *r) {
+    const gpu_capture_cmd *head = (const gpu_capture_cmd *)(r + 1);
+    gpu_verts *verts = gpu_verts_wrap((gpu_vert *)head->v, head->len);
+    if (verts == NULL) {
+        return NULL;
+    }
+    gpu_cmd *cmd;
+    if (head->instances) {
+        mat4 *mats = (mat4 *)(head->v + head->len);
+        gpu_color *colors = NULL;
+        if (head->colors) {
+            colors = (gpu_color *)(mats + head->instances);
+        }
+        cmd = gpu_cmd_wrap_instanced(head->primitive, verts, mats, colors,
+                                     head->instances, head->wireframe);
+    } else {
+        cmd = gpu_cmd_new(head->primitive, verts, head->wireframe);
+    }
+    gpu_verts_free(verts);
+    if (cmd == NULL) {
+        return NULL;
+    }
+    gpu_cmd_blend(cmd, head->blend);
+    if (! gpu_cmd_valid(cmd)) {
+        fprintf(stderr, "gpu_replay_open(): invalid command, primitive 0x%x blend 0x%x with %u vertices\n",
+                head->primitive, head->blend, head->len);
+        gpu_cmd_free(cmd);
+        return NULL;
+    }
+    return cmd;
+}
+
+// walks the records once to validate and count them, then builds every
+// command up front, so replaying a frame never parses or allocates
+static bool gpu_replay_index(gpu_replay *replay) {
+    const uint8_t *end = replay->map + replay->size;
+    const gpu_capture_header *header = (const gpu_capture_header *)replay->map;
+    if (replay->size < sizeof(*header) || header->magic != GPU_CAPTURE_MAGIC) {
+        fprintf(stderr, "gpu_replay_open(): not a capture file\n");
+        return false;
+    }
+    if (header->version != GPU_CAPTURE_VERSION) {
+        fprintf(stderr, "gpu_replay_open(): unsupported capture version %u\n", header->version);
+        return false;
+    }
+    const gpu_capture_record *first = (const gpu_capture_record *)(header + 1);
+    const gpu_capture_record *r = first;
+    uint32_t count = 0, len = 0, frames = 0;
+    while ((const uint8_t *)(r + 1) <= end) {
+        if (r->size > end - (const uint8_t *)(r + 1)) {
+            fprintf(stderr, "gpu_replay_open(): truncated capture, ignoring tail\n");
+            break;
+        }
+        if (! gpu_replay_record_valid(r)) {
+            fprintf(stderr, "gpu_replay_open(): corrupt record at offset %zu\n",
+                    (size_t)((const uint8_t *)r - replay->map));
+            return false;
+        }
+        if (r->tag == GPU_CAPTURE_FRAME) {
+            // records after the last frame are never replayed
+            frames++;
+            len = count + 1;
+        }
+        count++;
+        r = record_next(r);
+    }
+
+    replay->ops = calloc(len ? len : 1, sizeof(gpu_replay_op));
+    replay->frames = malloc(sizeof(uint32_t) * (frames ? frames : 1));
+    if (replay->ops == NULL || replay->frames == NULL) {
+        fprintf(stderr, "gpu_replay_open(): Out of memory\n");
+        return false;
+    }
+    for (r = first; replay->frame_count < frames; r = record_next(r)) {
+        gpu_replay_op *op = &replay->ops[replay->len++];
+        op->record = r;
+        if (r->tag == GPU_CAPTURE_CMD) {
+            op->cmd = gpu_replay_cmd_new(r);
+            if (op->cmd == NULL) {
+                return false;
+            }
+        } else if (r->tag == GPU_CAPTURE_FRAME) {
+            replay->frames[replay->frame_count++] = replay->len - 1;
+        }
+    }
+    return true;
+}
+gpu_replay *gpu_replay_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "gpu_replay_open(): could not open %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "gpu_replay_open(): could not map %s\n", path);
+        return NULL;
+    }
+
+    gpu_replay *replay = calloc(1, sizeof(gpu_replay));
+    replay->map = map;
+    replay->size = st.st_size;
+    if (! gpu_replay_index(replay)) {
+        gpu_replay_close(replay);
+        return NULL;
+    }
+    return replay;
+}
+
+void gpu_replay_close(gpu_replay *replay) {
+    for (uint32_t i = 0; i < replay->len; i++) {
+        if (replay->ops[i].cmd) {
+            gpu_cmd_free(replay->ops[i].cmd);
+        }
+    }
+    free(replay->ops);
+    free(replay->frames);
+    munmap((void *)replay->map, replay->size);
+    free(replay);
+}
+
+uint32_t gpu_replay_frames(gpu_replay *replay) {
+    return replay->frame_count;
+}
+
+bool gpu_replay_size(gpu_replay *replay, uint32_t index, uint32_t *width, uint32_t *height) {
+    if (index >= replay->frame_count) return false;
+    const gpu_capture_record *r = replay->ops[replay->frames[index]].record;
+    const gpu_capture_frame *head = (const gpu_capture_frame *)(r + 1);
+    *width = head->width;
+    *height = head->height;
+    return true;
+}
+
+bool gpu_replay_frame(gpu_replay *replay, uint32_t index, gpu_frame *frame) {
+    if (index >= replay->frame_count) return false;
+    uint32_t i = index ? replay->frames[index - 1] + 1 : 0;
+    for (; i < replay->frames[index]; i++) {
+        const gpu_replay_op *op = &replay->ops[i];
+        switch (op->record->tag) {
+        case GPU_CAPTURE_CLEAR:
+            gpu_frame_clear(frame, *(const gpu_color *)(op->record + 1));
+            break;
+        case GPU_CAPTURE_CMD:
+            // commands belong to the replay, so they are drawn directly
+            // rather than queued, which would free them
+            if (frame->capture) {
+                gpu_capture_cmd_write(frame->capture, op->cmd);
+            }
+            gpu_cmd_draw(op->cmd, frame);
+            break;
+        }
+    }
+    gpu_frame_render(frame);
+    return true;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "mm.h"
+#include "pool.h"
+#include "skin.h"
+#include "verts.h"
+
+// skinning costs several transforms per vertex, so it goes wide sooner
+#define GPU_SKIN_CHUNK (8 * 1024)
+#define GPU_SKIN_PARALLEL (2 * GPU_SKIN_CHUNK)
+
+// every vertex starts fully bound to bone 0
+gpu_skin *gpu_skin_new(uint32_t len, uint32_t bones) {
+    if (bones == 0 || bones > 256) {
+        fprintf(stderr, "gpu_skin_new(): Need 1 to 256 bones, got %u\n", bones);
+        return NULL;
+    }
+    gpu_skin *skin = calloc(1, sizeof(gpu_skin));
+    skin->len = len;
+    skin->bones = bones;
+    // weights first so each row is a single aligned load
+    size_t weights = sizeof(*skin->weight) * len;
+    uint8_t *data = memalign_alloc(16, weights + sizeof(*skin->index) * len);
+    if (data == NULL) {
+        free(skin);
+        return NULL;
+    }
+    skin->weight = (void *)data;
+    skin->index = (void *)(data + weights);
+    memset(data, 0, weights + sizeof(*skin->index) * len);
+    for (uint32_t i = 0; i < len; i++) {
+        skin->weight[i][0] = 1.0f;
+    }
+    return skin;
+}
+
+void gpu_skin_free(gpu_skin *skin) {
+    if (skin == NULL) {
+        return;
+    }
+    memalign_free(skin->weight);
+    free(skin);
+}
+
+// sets up to GPU_SKIN_BONES influences for vertex i. weights are
+// normalized to sum to 1, so the blend never scales the mesh.
+bool gpu_skin_set(gpu_skin *skin, uint32_t i, const uint8_t *index, const float *weight, uint32_t count) {
+    if (i >= skin->len || count > GPU_SKIN_BONES) {
+        fprintf(stderr, "gpu_skin_set(): Vertex %u with %u bones out of range\n", i, count);
+        return false;
+    }
+    float sum = 0;
+    for (uint32_t j = 0; j < count; j++) {
+        if (index[j] >= skin->bones) {
+            fprintf(stderr, "gpu_skin_set(): Bone %u out of range\n", index[j]);
+            return false;
+        }
+        sum += weight[j];
+    }
+    if (sum <= 0) {
+        fprintf(stderr, "gpu_skin_set(): Weights of vertex %u sum to %g\n", i, sum);
+        return false;
+    }
+    for (uint32_t j = 0; j < GPU_SKIN_BONES; j++) {
+        skin->index[i][j] = j < count ? index[j] : 0;
+        skin->weight[i][j] = j < count ? weight[j] / sum : 0;
+    }
+    return true;
+}
+
+typedef struct {
+    const gpu_kernels *kernels;
+    gpu_skin *skin;
+    const mat4 *palette;
+    gpu_verts *out, *in;
+} gpu_skin_job;
+
+static void gpu_skin_chunk(void *ctx, uint32_t index) {
+    gpu_skin_job *job = ctx;
+    uint32_t begin = index * GPU_SKIN_CHUNK;
+    uint32_t end = begin + GPU_SKIN_CHUNK < job->in->len ? begin + GPU_SKIN_CHUNK : job->in->len;
+    job->kernels->skin(job->skin, job->palette, job->out, job->in, begin, end);
+}
+
+// deforms the positions of in by the weighted sum of its bones from
+// palette, which holds skin->bones matrices. the output follows the rules
+// of gpu_verts_transform(), so it is float and can then be transformed as
+// usual. packed positions are decoded by folding the decode into a copy of
+// the palette.
+gpu_verts *gpu_skin_apply(gpu_skin *skin, const mat4 *palette, gpu_verts *out, gpu_verts *in) {
+    if (skin->len != in->len) {
+        fprintf(stderr, "gpu_skin_apply(): Skin has %u vertices, mesh has %u\n", skin->len, in->len);
+        return NULL;
+    }
+    bool created = false;
+    if (out == NULL) {
+        out = gpu_verts_new_layout(in->len, in->layout);
+        created = true;
+    } else if (out != in) {
+        if (! gpu_verts_reshape(out, in->len, in->layout, GPU_FLOAT, GPU_FLOAT, true)) {
+            return NULL;
+        }
+    } else if (gpu_verts_packed(in)) {
+        fprintf(stderr, "gpu_skin_apply(): Can't skin packed vertices in place\n");
+        return NULL;
+    }
+    mat4 *decoded = NULL;
+    if (in->pos_type != GPU_FLOAT) {
+        decoded = memalign_alloc(16, sizeof(mat4) * skin->bones);
+        if (decoded == NULL) {
+            if (created) {
+                gpu_verts_free(out);
+            }
+            return NULL;
+        }
+        mat4 decode, identity = mat4_new();
+        gpu_verts_decode_mat(in, &identity, &decode);
+        mat4_array_mul(decoded, palette, &decode, skin->bones);
+        palette = decoded;
+    }
+    gpu_skin_job job = {gpu_kernels_get(), skin, palette, out, in};
+    if (in->len < GPU_SKIN_PARALLEL) {
+        job.kernels->skin(skin, palette, out, in, 0, in->len);
+    } else {
+        pool_run(pool_default(), gpu_skin_chunk, &job,
+                 (in->len + GPU_SKIN_CHUNK - 1) / GPU_SKIN_CHUNK);
+    }
+    memalign_free(decoded);
+    return out;
+}
@@ -0,0 +1,14 @@
+#ifndef GPU_SKIN_H
+#define GPU_SKIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+gpu_skin *gpu_skin_new(uint32_t len, uint32_t bones);
+void gpu_skin_free(gpu_skin *skin);
+bool gpu_skin_set(gpu_skin *skin, uint32_t i, const uint8_t *index, const float *weight, uint32_t count);
+gpu_verts *gpu_skin_apply(gpu_skin *skin, const mat4 *palette, gpu_verts *out, gpu_verts *in);
+
+#endif
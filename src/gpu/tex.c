@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "enum.h"
+#include "kernels.h"
+#include "srgb.h"
+#include "tex.h"
+
+// decoded blocks kept per thread. slots go by the low 4 bits of a block's
+// x and y, so any 16x16 blocks (64x64 texels) of a texture fit at once.
+#define GPU_TEX_CACHE 256
+
+typedef struct {
+    // serial of the upload the block came from, 0 for an empty slot
+    uint64_t serial;
+    uint32_t block;
+    gpu_color texel[16];
+} gpu_tex_cached;
+
+// texel bytes to linear floats, [1] for GPU_TEX_SRGB textures. alpha
+// always goes through [0].
+static float tex_linear[2][256];
+static pthread_key_t tex_cache_key;
+
+static pthread_mutex_t tex_serial_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t tex_serial;
+
+static void tex_init() {
+    const srgb_tables_t *tables = srgb_tables();
+    for (int i = 0; i < 256; i++) {
+        tex_linear[0][i] = i / 255.0f;
+        tex_linear[1][i] = tables->to_linear[i];
+    }
+    pthread_key_create(&tex_cache_key, free);
+}
+
+static uint64_t tex_next_serial() {
+    pthread_mutex_lock(&tex_serial_lock);
+    uint64_t serial = ++tex_serial;
+    pthread_mutex_unlock(&tex_serial_lock);
+    return serial;
+}
+
+// bytes per 4x4 block, 0 for formats that aren't blocks
+static size_t tex_block_size(uint32_t format) {
+    switch (format) {
+    case GPU_BC1:
+    case GPU_ETC1:
+        return 8;
+    case GPU_BC3:
+        return 16;
+    }
+    return 0;
+}
+
+size_t gpu_tex_sizeof(const gpu_tex *tex) {
+    if (tex->format == GPU_RGBA8) {
+        return (size_t)tex->width * tex->height * sizeof(gpu_color);
+    }
+    return (size_t)((tex->width + 3) / 4) * ((tex->height + 3) / 4) * tex_block_size(tex->format);
+}
+
+static gpu_tex *tex_alloc(const char *fn, uint32_t width, uint32_t height, uint32_t format) {
+    if (width == 0 || height == 0) {
+        fprintf(stderr, "%s(): Can't make a %ux%u texture\n", fn, width, height);
+        return NULL;
+    }
+    gpu_tex probe = {width, height, 0, format};
+    gpu_tex *tex = calloc(1, sizeof(gpu_tex) + gpu_tex_sizeof(&probe));
+    if (tex == NULL) {
+        fprintf(stderr, "%s(): Out of memory for %ux%u texture\n", fn, width, height);
+        return NULL;
+    }
+    *tex = probe;
+    return tex;
+}
+
+gpu_tex *gpu_tex_new(uint32_t width, uint32_t height) {
+    return tex_alloc("gpu_tex_new", width, height, GPU_RGBA8);
+}
+
+// a texture of zeroed blocks, see gpu_tex_blocks(). set GPU_TEX_SRGB in
+// flags for blocks of sRGB encoded colors, and GPU_TEX_PREMULTIPLIED for
+// premultiplied ones.
+gpu_tex *gpu_tex_new_blocks(uint32_t width, uint32_t height, uint32_t format) {
+    if (tex_block_size(format) == 0) {
+        fprintf(stderr, "gpu_tex_new_blocks(): Unknown block format 0x%x\n", format);
+        return NULL;
+    }
+    gpu_tex *tex = tex_alloc("gpu_tex_new_blocks", width, height, format);
+    if (tex) {
+        tex->serial = tex_next_serial();
+    }
+    return tex;
+}
+
+void gpu_tex_free(gpu_tex *tex) {
+    free(tex);
+}
+
+// replaces every texel with pixels, laid out as unpack says (NULL for
+// tightly packed). sRGB formats are stored as they are and flag the
+// texture GPU_TEX_SRGB, everything else is stored linear. premultiplying
+// in options flags it GPU_TEX_PREMULTIPLIED.
+bool gpu_tex_image(gpu_tex *tex, const void *pixels, const pixel_unpack_t *unpack,
+                   uint32_t format, uint32_t type, const pixel_options_t *options) {
+    if (tex->format != GPU_RGBA8) {
+        fprintf(stderr, "gpu_tex_image(): Can't compress pixels, upload blocks instead\n");
+        return false;
+    }
+    bool srgb = pixel_format_srgb(format);
+    if (! pixel_convert_rect(pixels, unpack, tex->width, tex->height, format, type,
+                             tex->data, 0, srgb ? GL_SRGB_ALPHA : GL_RGBA, GL_UNSIGNED_BYTE, options)) {
+        return false;
+    }
+    bool premultiplied = options && options->premultiply;
+    tex->flags &= ~(GPU_TEX_SRGB | GPU_TEX_PREMULTIPLIED);
+    tex->flags |= (srgb ? GPU_TEX_SRGB : 0) | (premultiplied ? GPU_TEX_PREMULTIPLIED : 0);
+    return true;
+}
+
+// replaces every block, given as they're stored in compressed texture
+// files: rows of blocks, top to bottom, with partial blocks at the edges
+bool gpu_tex_blocks(gpu_tex *tex, const void *blocks, size_t size) {
+    if (tex->format == GPU_RGBA8) {
+        fprintf(stderr, "gpu_tex_blocks(): Texture isn't block compressed\n");
+        return false;
+    }
+    if (size != gpu_tex_sizeof(tex)) {
+        fprintf(stderr, "gpu_tex_blocks(): Need %zu bytes of blocks for %ux%u, got %zu\n",
+                gpu_tex_sizeof(tex), tex->width, tex->height, size);
+        return false;
+    }
+    memcpy(tex->data, blocks, size);
+    tex->serial = tex_next_serial();
+    return true;
+}
+
+static gpu_tex_cached *tex_cache() {
+    gpu_tex_cached *cache = pthread_getspecific(tex_cache_key);
+    if (cache == NULL) {
+        cache = calloc(GPU_TEX_CACHE, sizeof(gpu_tex_cached));
+        pthread_setspecific(tex_cache_key, cache);
+    }
+    return cache;
+}
+
+// texel (x, y), decoding its block into the cache if it isn't there.
+// without a cache the block is decoded every time.
+static inline gpu_color tex_texel(const gpu_tex *tex, gpu_tex_cached *cache, uint32_t x, uint32_t y) {
+    if (tex->format == GPU_RGBA8) {
+        return tex->data[(size_t)y * tex->width + x];
+    }
+    uint32_t bx = x / 4, by = y / 4;
+    uint32_t block = by * ((tex->width + 3) / 4) + bx;
+    gpu_tex_cached scratch, *slot = &scratch;
+    scratch.serial = 0;
+    if (cache) {
+        // textures start at different slots, so small ones don't all
+        // compete for the first few
+        uint32_t base = (uint32_t)(tex->serial * 0x9E3779B97F4A7C15ull >> 56);
+        slot = &cache[((bx & 15) | (by & 15) << 4) ^ base];
+    }
+    if (slot->serial != tex->serial || slot->block != block) {
+        const uint8_t *src = (const uint8_t *)tex->data + (size_t)block * tex_block_size(tex->format);
+        gpu_kernels_get()->decode_blocks(tex->format, src, 1, slot->texel);
+        slot->serial = tex->serial;
+        slot->block = block;
+    }
+    return slot->texel[(y & 3) * 4 + (x & 3)];
+}
+
+// bilinear sample at (s, t), repeating at the edges, as linear RGBA,
+// premultiplied if the texture is. sRGB texels are decoded before
+// filtering, through a table.
+void gpu_tex_sample(const gpu_tex *tex, float s, float t, float out[4]) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, tex_init);
+    const float *color = tex_linear[(tex->flags & GPU_TEX_SRGB) != 0], *alpha = tex_linear[0];
+    gpu_tex_cached *cache = tex->format == GPU_RGBA8 ? NULL : tex_cache();
+
+    // texel centers are at +0.5, so the left neighbor can be texel -1
+    float u = (s - floorf(s)) * tex->width - 0.5f;
+    float v = (t - floorf(t)) * tex->height - 0.5f;
+    float fu = floorf(u), fv = floorf(v);
+    int32_t x0 = fu, y0 = fv;
+    float wx = u - fu, wy = v - fv;
+    uint32_t x1 = x0 + 1 < tex->width ? x0 + 1 : 0, y1 = y0 + 1 < tex->height ? y0 + 1 : 0;
+    x0 = x0 < 0 ? tex->width - 1 : x0;
+    y0 = y0 < 0 ? tex->height - 1 : y0;
+
+    gpu_color texel[4] = {
+        tex_texel(tex, cache, x0, y0), tex_texel(tex, cache, x1, y0),
+        tex_texel(tex, cache, x0, y1), tex_texel(tex, cache, x1, y1),
+    };
+    float weight[4] = {
+        (1 - wx) * (1 - wy), wx * (1 - wy),
+        (1 - wx) * wy, wx * wy,
+    };
+    out[0] = out[1] = out[2] = out[3] = 0;
+    for (int i = 0; i < 4; i++) {
+        out[0] += color[texel[i].r] * weight[i];
+        out[1] += color[texel[i].g] * weight[i];
+        out[2] += color[texel[i].b] * weight[i];
+        out[3] += alpha[texel[i].a] * weight[i];
+    }
+}
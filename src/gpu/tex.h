@@ -0,0 +1,20 @@
+#ifndef GPU_TEX_H
+#define GPU_TEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pixel.h"
+#include "types.h"
+
+gpu_tex *gpu_tex_new(uint32_t width, uint32_t height);
+gpu_tex *gpu_tex_new_blocks(uint32_t width, uint32_t height, uint32_t format);
+void gpu_tex_free(gpu_tex *tex);
+bool gpu_tex_image(gpu_tex *tex, const void *pixels, const pixel_unpack_t *unpack,
+                   uint32_t format, uint32_t type, const pixel_options_t *options);
+bool gpu_tex_blocks(gpu_tex *tex, const void *blocks, size_t size);
+size_t gpu_tex_sizeof(const gpu_tex *tex);
+void gpu_tex_sample(const gpu_tex *tex, float s, float t, float out[4]);
+
+#endif
@@ -5,6 +5,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "matrix.h"
 #include "tack.h"
 
 typedef struct {
@@ -26,25 +27,146 @@ typedef struct {
 } gpu_vert;
 
 typedef struct {
-    uint32_t len;
+    gpu_pos min, max;
+} gpu_bounds;
+
+enum {
+    GPU_VERTS_AOS,
+    GPU_VERTS_SOA,
+};
+
+typedef struct {
+    uint32_t len, cap;
+    uint32_t layout;
+    // interleaved storage, only set for GPU_VERTS_AOS
     gpu_vert *v;
+    // every stage reads attributes through these streams, which point into
+    // v for AOS and at separate aligned arrays for SOA
+    gpu_pos *pos;
+    gpu_color *color;
+    gpu_tex_coord *tex;
+    uint32_t pos_stride, color_stride, tex_stride;
+    // optional float normals, NULL until gpu_verts_normals(). kept in a
+    // block of their own (with a spare element) for either layout, so
+    // interleaved vertices stay 32 bytes.
+    gpu_pos *normal;
+    // GPU_FLOAT unless made by gpu_verts_new_packed(), which stores
+    // positions as normalized GPU_SHORT/GPU_UNSIGNED_SHORT and texture
+    // coordinates as GPU_HALF_FLOAT. packed streams are decoded by the
+    // transform, so only float vertices are ever rasterized.
+    uint32_t pos_type, tex_type;
+    // a packed position decodes to pos_offset + pos_scale * normalized value
+    gpu_pos pos_scale, pos_offset;
+    void *data;
+    // commands hold references, the last gpu_verts_free() releases storage
+    uint32_t refs;
+    // data points at memory owned by someone else (eg. a mapped capture)
+    bool borrowed;
 } gpu_verts;
 
+#define GPU_SKIN_BONES 4
+
+// per vertex bone influences for gpu_skin_apply(). unused slots have
+// weight 0, and every index is below bones.
+typedef struct {
+    uint32_t len, bones;
+    float (*weight)[GPU_SKIN_BONES];
+    uint8_t (*index)[GPU_SKIN_BONES];
+} gpu_skin;
+
+#define GPU_LIGHTS 8
+
+// a GL 1.x light. position is already in eye space, w = 0 makes it
+// directional. spot lights aren't supported.
+typedef struct {
+    bool enabled;
+    float position[4];
+    float ambient[4], diffuse[4], specular[4];
+    float constant, linear, quadratic;
+} gpu_light;
+
+typedef struct {
+    float ambient[4], diffuse[4], specular[4], emission[4];
+    float shininess;
+} gpu_material;
+
+// fixed function lighting state, see gpu_light_apply(). the viewer is at
+// infinity and only front faces are lit, like the GL defaults.
+typedef struct {
+    gpu_light light[GPU_LIGHTS];
+    gpu_material material;
+    // GL_LIGHT_MODEL_AMBIENT
+    float ambient[4];
+    // vertex colors stand in for the ambient and diffuse material, like
+    // GL_COLOR_MATERIAL with GL_AMBIENT_AND_DIFFUSE
+    bool color_material;
+} gpu_lighting;
+
+enum {
+    // texels hold sRGB encoded colors, which sampling decodes to linear
+    GPU_TEX_SRGB = 1 << 0,
+    // colors are already multiplied by alpha, so filtering has no fringes
+    // and blending skips the multiply
+    GPU_TEX_PREMULTIPLIED = 1 << 1,
+};
+
 typedef struct {
     uint32_t width, height;
+    // GPU_TEX_* bits
+    uint32_t flags;
+    // GPU_RGBA8 texels in data, or GPU_BC1/GPU_BC3/GPU_ETC1 blocks stored
+    // there as bytes, row by row, which sampling decodes as it goes
+    uint32_t format;
+    // unique to every upload of blocks, so decoded ones are never mixed up
+    uint64_t serial;
     gpu_color data[];
 } gpu_tex;
 
+typedef struct gpu_capture gpu_capture;
+
 typedef struct {
     uint32_t width, height;
+    // bytes between rows, and the GPU_* format pixels are stored in
+    uint32_t pitch, format, bpp;
     tack_t queue;
-    gpu_color *buf;
+    uint8_t *buf;
+    gpu_capture *capture;
 } gpu_frame;
 
+typedef struct gpu_bundle gpu_bundle;
+
 typedef struct {
     uint32_t primitive;
     gpu_verts *verts;
     bool wireframe;
+    // filled triangles sample tex if set, which the caller keeps alive,
+    // and otherwise blend their colors by blend (0 for none)
+    const gpu_tex *tex;
+    uint32_t blend;
+    // instanced commands draw verts once per matrix, reusing scratch
+    uint32_t instances;
+    mat4 *mats;
+    gpu_color *colors;
+    gpu_verts *scratch;
+    // mats composed under a top level matrix, see gpu_cmd_draw_under()
+    mat4 *world;
+    // mats and colors belong to someone else, see gpu_cmd_wrap_instanced()
+    bool borrowed;
+    // bundle commands replay a prebuilt list under mats[0], if set
+    gpu_bundle *bundle;
 } gpu_cmd;
 
+struct gpu_bundle {
+    uint32_t refs;
+    uint32_t len;
+    gpu_cmd **cmds;
+    // object space bounds per command, plus the union of them all
+    gpu_bounds *bounds;
+    gpu_bounds total;
+    // no instanced or nested commands, so total alone decides culling
+    bool flat;
+    // shared by every command drawn under a top level matrix
+    gpu_verts *scratch;
+};
+
 #endif
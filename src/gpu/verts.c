@@ -1,33 +1,543 @@
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "enum.h"
+#include "gpu_helpers.h"
+#include "kernels.h"
 #include "mm.h"
+#include "pool.h"
+#include "vectorial/simd8f.h"
 #include "verts.h"
+#include "verts_simd.h"
+
+#define GPU_VERTS_ALIGN 32
+// transforms of at least GPU_VERTS_PARALLEL vertices are split into chunks
+// for the worker pool
+#define GPU_VERTS_CHUNK (16 * 1024)
+#define GPU_VERTS_PARALLEL (4 * GPU_VERTS_CHUNK)
+
+static inline size_t gpu_verts_align(size_t size) {
+    return (size + GPU_VERTS_ALIGN - 1) & ~(size_t)(GPU_VERTS_ALIGN - 1);
+}
+
+// packed positions carry a fourth (unused) component so each one is a
+// single 8 byte load
+static inline uint32_t gpu_verts_pos_sizeof(uint32_t type) {
+    return type == GPU_FLOAT ? sizeof(gpu_pos) : gl_sizeof(type) * 4;
+}
+
+static inline uint32_t gpu_verts_tex_sizeof(uint32_t type) {
+    return gl_sizeof(type) * 4;
+}
+
+// SOA keeps all three streams in one block, each starting on a 32 byte
+// boundary. the position stream has one spare element so a whole simd4f
+// can be loaded from or stored to the last position.
+static size_t gpu_verts_storage_size(gpu_verts *v, uint32_t cap) {
+    if (v->layout == GPU_VERTS_SOA) {
+        return gpu_verts_align(gpu_verts_pos_sizeof(v->pos_type) * (cap + 1)) +
+               gpu_verts_align(sizeof(gpu_color) * cap) +
+               gpu_verts_align(gpu_verts_tex_sizeof(v->tex_type) * cap);
+    }
+    return sizeof(gpu_vert) * cap;
+}
+
+// points the streams into data, using the layout and types already in v
+static void gpu_verts_bind(gpu_verts *v, void *data, uint32_t cap) {
+    v->data = data;
+    v->cap = cap;
+    if (v->layout == GPU_VERTS_SOA) {
+        uint8_t *base = data;
+        v->v = NULL;
+        v->pos_stride = gpu_verts_pos_sizeof(v->pos_type);
+        v->color_stride = sizeof(gpu_color);
+        v->tex_stride = gpu_verts_tex_sizeof(v->tex_type);
+        v->pos = (gpu_pos *)base;
+        base += gpu_verts_align(v->pos_stride * (cap + 1));
+        v->color = (gpu_color *)base;
+        base += gpu_verts_align(v->color_stride * cap);
+        v->tex = (gpu_tex_coord *)base;
+    } else {
+        v->v = data;
+        v->pos = &v->v->pos;
+        v->color = &v->v->color;
+        v->tex = &v->v->tex;
+        v->pos_stride = v->color_stride = v->tex_stride = sizeof(gpu_vert);
+    }
+}
+
+static inline void gpu_verts_format(gpu_verts *v, uint32_t layout, uint32_t pos_type, uint32_t tex_type) {
+    v->layout = layout;
+    v->pos_type = pos_type;
+    v->tex_type = tex_type;
+    v->pos_scale = (gpu_pos){1, 1, 1};
+    v->pos_offset = (gpu_pos){0, 0, 0};
+}
+
+// copies len vertices, converting between float layouts if needed. packed
+// vertices can only be copied to the same format.
+static void gpu_verts_move(gpu_verts *out, gpu_verts *in, uint32_t len) {
+    if (out->layout == GPU_VERTS_AOS && in->layout == GPU_VERTS_AOS) {
+        memcpy(out->v, in->v, sizeof(gpu_vert) * len);
+    } else if (out->layout == GPU_VERTS_SOA && in->layout == GPU_VERTS_SOA) {
+        memcpy(out->pos, in->pos, (size_t)in->pos_stride * len);
+        memcpy(out->color, in->color, (size_t)in->color_stride * len);
+        memcpy(out->tex, in->tex, (size_t)in->tex_stride * len);
+    } else {
+        for (uint32_t i = 0; i < len; i++) {
+            *gpu_verts_pos(out, i) = *gpu_verts_pos(in, i);
+            *gpu_verts_color(out, i) = *gpu_verts_color(in, i);
+            *gpu_verts_tex(out, i) = *gpu_verts_tex(in, i);
+        }
+    }
+    if (out->normal && in->normal && out->normal != in->normal) {
+        memcpy(out->normal, in->normal, sizeof(gpu_pos) * len);
+    }
+    out->pos_scale = in->pos_scale;
+    out->pos_offset = in->pos_offset;
+}
 
 gpu_verts *gpu_verts_new(uint32_t len) {
-    gpu_verts *v = malloc(sizeof(gpu_verts));
+    return gpu_verts_new_layout(len, GPU_VERTS_AOS);
+}
+
+static gpu_verts *gpu_verts_new_format(uint32_t len, uint32_t layout, uint32_t pos_type, uint32_t tex_type) {
+    gpu_verts *v = calloc(1, sizeof(gpu_verts));
+    if (v == NULL) {
+        return NULL;
+    }
+    v->len = len;
+    v->refs = 1;
+    gpu_verts_format(v, layout, pos_type, tex_type);
+    void *data = memalign_alloc(GPU_VERTS_ALIGN, gpu_verts_storage_size(v, len));
+    if (data == NULL) {
+        free(v);
+        return NULL;
+    }
+    gpu_verts_bind(v, data, len);
+    return v;
+}
+
+gpu_verts *gpu_verts_new_layout(uint32_t len, uint32_t layout) {
+    return gpu_verts_new_format(len, layout, GPU_FLOAT, GPU_FLOAT);
+}
+
+// packed vertices are always SOA. fill them with gpu_verts_pack().
+gpu_verts *gpu_verts_new_packed(uint32_t len, uint32_t pos_type, uint32_t tex_type) {
+    switch (pos_type) {
+    case GPU_FLOAT:
+    case GPU_SHORT:
+    case GPU_UNSIGNED_SHORT:
+        break;
+    default:
+        fprintf(stderr, "gpu_verts_new_packed(): Unsupported position type 0x%x\n", pos_type);
+        return NULL;
+    }
+    if (tex_type != GPU_FLOAT && tex_type != GPU_HALF_FLOAT) {
+        fprintf(stderr, "gpu_verts_new_packed(): Unsupported texture coordinate type 0x%x\n", tex_type);
+        return NULL;
+    }
+    return gpu_verts_new_format(len, GPU_VERTS_SOA, pos_type, tex_type);
+}
+
+gpu_verts *gpu_verts_wrap(gpu_vert *data, uint32_t len) {
+    gpu_verts *v = calloc(1, sizeof(gpu_verts));
+    if (v == NULL) {
+        return NULL;
+    }
     v->len = len;
-    v->v = malloc(sizeof(gpu_vert) * len);
+    v->refs = 1;
+    v->borrowed = true;
+    gpu_verts_format(v, GPU_VERTS_AOS, GPU_FLOAT, GPU_FLOAT);
+    gpu_verts_bind(v, data, len);
     return v;
 }
 
 gpu_verts *gpu_verts_copy(gpu_verts *in) {
-    gpu_verts *out = gpu_verts_new(in->len);
-    memcpy(out->v, in->v, sizeof(gpu_vert) * in->len);
+    gpu_verts *out = gpu_verts_new_format(in->len, in->layout, in->pos_type, in->tex_type);
+    if (out == NULL) {
+        return NULL;
+    }
+    if (in->normal && ! gpu_verts_normals(out)) {
+        gpu_verts_free(out);
+        return NULL;
+    }
+    gpu_verts_move(out, in, in->len);
     return out;
 }
 
+gpu_verts *gpu_verts_ref(gpu_verts *v) {
+    v->refs++;
+    return v;
+}
+
 void gpu_verts_free(gpu_verts *v) {
-    free(v->v);
+    if (v == NULL || --v->refs > 0) {
+        return;
+    }
+    if (! v->borrowed) {
+        memalign_free(v->data);
+    }
+    memalign_free(v->normal);
     free(v);
 }
 
+// points normals [from, cap] of v back at +z, the spare one included
+static void gpu_verts_normals_reset(gpu_verts *v, uint32_t from) {
+    for (uint32_t i = from; i <= v->cap; i++) {
+        v->normal[i] = (gpu_pos){0, 0, 1};
+    }
+}
+
+// makes out carry the normals of in, if it has any
+static bool gpu_verts_copy_normals(gpu_verts *out, gpu_verts *in) {
+    if (in->normal == NULL || out->normal == in->normal) {
+        return true;
+    }
+    if (! gpu_verts_normals(out)) {
+        return false;
+    }
+    memcpy(out->normal, in->normal, sizeof(gpu_pos) * in->len);
+    return true;
+}
+
+// changes storage to the given format, keeping the first len vertices
+// unless discard. keeping them only works between float formats or when
+// the format doesn't change.
+bool gpu_verts_reshape(gpu_verts *v, uint32_t len, uint32_t layout,
+                       uint32_t pos_type, uint32_t tex_type, bool discard) {
+    bool same = layout == v->layout && pos_type == v->pos_type && tex_type == v->tex_type;
+    if (len <= v->cap && same) {
+        v->len = len;
+        return true;
+    }
+    if (v->borrowed) {
+        return false;
+    }
+    uint32_t cap = len > v->cap ? len : v->cap;
+    gpu_verts old = *v;
+    gpu_verts_format(v, layout, pos_type, tex_type);
+    void *data = memalign_alloc(GPU_VERTS_ALIGN, gpu_verts_storage_size(v, cap));
+    // normals follow the capacity, they don't depend on the format
+    if (data != NULL && old.normal && cap > old.cap) {
+        v->normal = memalign_alloc(GPU_VERTS_ALIGN, sizeof(gpu_pos) * (cap + 1));
+        if (v->normal == NULL) {
+            memalign_free(data);
+            data = NULL;
+        }
+    }
+    if (data == NULL) {
+        *v = old;
+        return false;
+    }
+    gpu_verts_bind(v, data, cap);
+    uint32_t kept = discard ? 0 : old.len < len ? old.len : len;
+    if (v->normal) {
+        // anything not carried over faces +z, like gpu_verts_normals()
+        gpu_verts_normals_reset(v, v->normal == old.normal ? kept : 0);
+    }
+    if (! discard) {
+        gpu_verts_move(v, &old, kept);
+    }
+    if (v->normal != old.normal) {
+        memalign_free(old.normal);
+    }
+    memalign_free(old.data);
+    v->len = len;
+    return true;
+}
+
+// adds a normal stream to v, with every normal facing +z. the stream then
+// lives as long as v and grows with it.
+bool gpu_verts_normals(gpu_verts *v) {
+    if (v->normal) {
+        return true;
+    }
+    v->normal = memalign_alloc(GPU_VERTS_ALIGN, sizeof(gpu_pos) * ((size_t)v->cap + 1));
+    if (v->normal == NULL) {
+        return false;
+    }
+    gpu_verts_normals_reset(v, 0);
+    return true;
+}
+
+// scratch buffers only ever grow, so reusing one across frames settles
+// into zero allocations once it has seen the largest mesh
+bool gpu_verts_resize(gpu_verts *v, uint32_t len) {
+    return gpu_verts_reshape(v, len, v->layout, v->pos_type, v->tex_type, false);
+}
+
+// rounds to nearest even
+static inline uint16_t gpu_float_to_half(float f) {
+    gpu_bits v = {.f = f};
+    uint32_t sign = v.u & 0x80000000u;
+    uint16_t o;
+    v.u ^= sign;
+    if (v.u >= (127 + 16) << 23) {
+        o = v.u > 255u << 23 ? 0x7e00 : 0x7c00;
+    } else if (v.u < 113 << 23) {
+        gpu_bits magic = {.u = ((127 - 15) + (23 - 10) + 1) << 23};
+        v.f += magic.f;
+        o = v.u - magic.u;
+    } else {
+        uint32_t odd = (v.u >> 13) & 1;
+        v.u += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+        o = v.u >> 13;
+    }
+    return o | (sign >> 16);
+}
+
+static inline float gpu_verts_norm(uint32_t type) {
+    return type == GPU_FLOAT ? 1.0f : 1.0f / gl_max_value(type);
+}
+
+static void gpu_verts_decode_pos(gpu_verts *v, uint32_t i, gpu_pos *out) {
+    if (v->pos_type == GPU_FLOAT) {
+        *out = *gpu_verts_pos(v, i);
+        return;
+    }
+    float f[3], norm = gpu_verts_norm(v->pos_type);
+    gpu_verts_load3(gpu_verts_pos(v, i), v->pos_type, f);
+    out->x = v->pos_offset.x + v->pos_scale.x * f[0] * norm;
+    out->y = v->pos_offset.y + v->pos_scale.y * f[1] * norm;
+    out->z = v->pos_offset.z + v->pos_scale.z * f[2] * norm;
+}
+
+// folds the position decode into mat, so the kernel only has to convert
+// the packed integers to float
+void gpu_verts_decode_mat(gpu_verts *v, const mat4 *mat, mat4 *out) {
+    float norm = gpu_verts_norm(v->pos_type);
+    *out = *mat;
+    mat4_translate(out, v->pos_offset.x, v->pos_offset.y, v->pos_offset.z);
+    mat4_scale(out, v->pos_scale.x * norm, v->pos_scale.y * norm, v->pos_scale.z * norm);
+}
+
+static inline int32_t gpu_verts_quantize(float value, float offset, float scale, uint32_t type) {
+    float n = (value - offset) / scale;
+    float lo = type == GPU_SHORT ? -1.0f : 0.0f;
+    n = n < lo ? lo : n > 1.0f ? 1.0f : n;
+    return lrintf(n * gl_max_value(type));
+}
+
+// encodes float vertices into out, which must come from
+// gpu_verts_new_packed(). the position scale and offset are picked to cover
+// the bounds of in.
+bool gpu_verts_pack(gpu_verts *out, gpu_verts *in) {
+    if (gpu_verts_packed(in) || out->layout != GPU_VERTS_SOA) {
+        fprintf(stderr, "gpu_verts_pack(): Need float input and packed output\n");
+        return false;
+    }
+    if (! gpu_verts_resize(out, in->len)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < in->len; i++) {
+        *gpu_verts_color(out, i) = *gpu_verts_color(in, i);
+    }
+
+    if (out->pos_type == GPU_FLOAT) {
+        for (uint32_t i = 0; i < in->len; i++) {
+            *gpu_verts_pos(out, i) = *gpu_verts_pos(in, i);
+        }
+    } else {
+        gpu_bounds b;
+        gpu_verts_bounds(in, &b);
+        float *min = &b.min.x, *max = &b.max.x;
+        float *scale = &out->pos_scale.x, *offset = &out->pos_offset.x;
+        for (int c = 0; c < 3; c++) {
+            // signed values are centered, unsigned ones start at the minimum
+            bool sign = out->pos_type == GPU_SHORT;
+            float extent = max[c] - min[c];
+            offset[c] = sign ? min[c] + extent / 2 : min[c];
+            scale[c] = extent == 0 ? 1.0f : sign ? extent / 2 : extent;
+        }
+        for (uint32_t i = 0; i < in->len; i++) {
+            float *p = (float *)gpu_verts_pos(in, i);
+            int32_t q[4] = {0, 0, 0, 0};
+            for (int c = 0; c < 3; c++) {
+                q[c] = gpu_verts_quantize(p[c], offset[c], scale[c], out->pos_type);
+            }
+            if (out->pos_type == GPU_SHORT) {
+                int16_t *o = (int16_t *)gpu_verts_pos(out, i);
+                for (int c = 0; c < 4; c++) o[c] = q[c];
+            } else {
+                uint16_t *o = (uint16_t *)gpu_verts_pos(out, i);
+                for (int c = 0; c < 4; c++) o[c] = q[c];
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < in->len; i++) {
+        gpu_tex_coord *t = gpu_verts_tex(in, i);
+        if (out->tex_type == GPU_FLOAT) {
+            *gpu_verts_tex(out, i) = *t;
+        } else {
+            uint16_t *o = (uint16_t *)gpu_verts_tex(out, i);
+            o[0] = gpu_float_to_half(t->s);
+            o[1] = gpu_float_to_half(t->t);
+            o[2] = gpu_float_to_half(t->r);
+            o[3] = gpu_float_to_half(t->q);
+        }
+    }
+    return true;
+}
+
+// decodes in into float vertices of the same layout, normals included.
+// with out NULL a new gpu_verts is returned, otherwise out is treated as
+// scratch.
+gpu_verts *gpu_verts_unpack(gpu_verts *out, gpu_verts *in) {
+    bool created = out == NULL;
+    if (out == NULL) {
+        out = gpu_verts_new_layout(in->len, in->layout);
+        if (out == NULL) {
+            return NULL;
+        }
+    } else if (out == in) {
+        fprintf(stderr, "gpu_verts_unpack(): Can't unpack in place\n");
+        return NULL;
+    } else if (! gpu_verts_reshape(out, in->len, in->layout, GPU_FLOAT, GPU_FLOAT, true)) {
+        return NULL;
+    }
+    if (! gpu_verts_copy_normals(out, in)) {
+        if (created) {
+            gpu_verts_free(out);
+        }
+        return NULL;
+    }
+    if (! gpu_verts_packed(in)) {
+        gpu_verts_move(out, in, in->len);
+        return out;
+    }
+    if (in->pos_type == GPU_FLOAT) {
+        memcpy(out->pos, in->pos, sizeof(gpu_pos) * in->len);
+    } else {
+        float norm = gpu_verts_norm(in->pos_type);
+        gpu_pos *s = &in->pos_scale, *o = &in->pos_offset;
+        simd4f scale = simd4f_create(s->x * norm, s->y * norm, s->z * norm, 0);
+        simd4f offset = simd4f_create(o->x, o->y, o->z, 0);
+        // each store spills one float into the next position (or the spare
+        // one at the end), which the next store overwrites
+        for (uint32_t i = 0; i < in->len; i++) {
+            simd4f p = gpu_verts_load4(gpu_verts_pos(in, i), in->pos_type);
+            simd4f_ustore4(simd4f_madd(p, scale, offset), (float *)gpu_verts_pos(out, i));
+        }
+    }
+    gpu_verts_unpack_attribs(out, in, 0, in->len);
+    return out;
+}
+
+void gpu_verts_bounds(gpu_verts *v, gpu_bounds *out) {
+    if (v->len == 0) {
+        *out = (gpu_bounds){{0, 0, 0}, {0, 0, 0}};
+        return;
+    }
+    gpu_pos min, max;
+    gpu_verts_decode_pos(v, 0, &min);
+    max = min;
+    for (int i = 1; i < v->len; i++) {
+        gpu_pos pos, *p = &pos;
+        gpu_verts_decode_pos(v, i, p);
+        min.x = p->x < min.x ? p->x : min.x;
+        min.y = p->y < min.y ? p->y : min.y;
+        min.z = p->z < min.z ? p->z : min.z;
+        max.x = p->x > max.x ? p->x : max.x;
+        max.y = p->y > max.y ? p->y : max.y;
+        max.z = p->z > max.z ? p->z : max.z;
+    }
+    out->min = min;
+    out->max = max;
+}
+
+// conservative: false only if all eight corners land on the same side
+// outside the viewport. mat is expected to include the viewport mapping.
+// the corners are one simd8f per axis, one corner per lane.
+bool gpu_bounds_visible(const gpu_bounds *b, const mat4 *mat, uint32_t width, uint32_t height) {
+    const gpu_pos *lo = &b->min, *hi = &b->max;
+    simd8f x = simd8f_create(lo->x, hi->x, lo->x, hi->x, lo->x, hi->x, lo->x, hi->x);
+    simd8f y = simd8f_create(lo->y, lo->y, hi->y, hi->y, lo->y, lo->y, hi->y, hi->y);
+    simd8f z = simd8f_create(lo->z, lo->z, lo->z, lo->z, hi->z, hi->z, hi->z, hi->z);
+
+    float m[16];
+    mat4_save((mat4 *)mat, m);
+    #define row(r) simd8f_madd(simd8f_splat(m[0 + r]), x,  \
+                   simd8f_madd(simd8f_splat(m[4 + r]), y,  \
+                   simd8f_madd(simd8f_splat(m[8 + r]), z, simd8f_splat(m[12 + r]))))
+    simd8f w = row(3);
+    simd8f sx = simd8f_div(row(0), w);
+    simd8f sy = simd8f_div(row(1), w);
+    #undef row
+
+    float cw[8], cx[8], cy[8];
+    simd8f_ustore8(w, cw);
+    simd8f_ustore8(sx, cx);
+    simd8f_ustore8(sy, cy);
+    int left = 0, right = 0, above = 0, below = 0;
+    for (int i = 0; i < 8; i++) {
+        if (cw[i] <= 0) {
+            // behind the eye, the divide would flip it; don't guess
+            return true;
+        }
+        left += cx[i] < 0;
+        right += cx[i] >= width;
+        above += cy[i] < 0;
+        below += cy[i] >= height;
+    }
+    return !(left == 8 || right == 8 || above == 8 || below == 8);
+}
+
+typedef struct {
+    const gpu_kernels *kernels;
+    mat4 *mat;
+    gpu_verts *out, *in;
+} gpu_verts_job;
+
+static void gpu_verts_transform_chunk(void *ctx, uint32_t index) {
+    gpu_verts_job *job = ctx;
+    uint32_t begin = index * GPU_VERTS_CHUNK;
+    uint32_t end = begin + GPU_VERTS_CHUNK < job->in->len ? begin + GPU_VERTS_CHUNK : job->in->len;
+    job->kernels->transform(job->mat, job->out, job->in, begin, end);
+}
+
+// out always ends up as float vertices in the layout of in, with the
+// normals of in copied as they are, since lighting reads them in object
+// space. packed vertices can't be transformed in place.
+//
+// large meshes are split into GPU_VERTS_CHUNK sized ranges and run on the
+// default pool. every chunk writes only its own range of out, so the
+// workers share nothing.
 gpu_verts *gpu_verts_transform(mat4 *mat, gpu_verts *out, gpu_verts *in) {
+    bool created = out == NULL;
     if (out == NULL) {
-        out = gpu_verts_copy(in);
+        out = gpu_verts_new_layout(in->len, in->layout);
+        if (out == NULL) {
+            return NULL;
+        }
+    } else if (out != in) {
+        // out is treated as scratch, it takes on the layout of in
+        if (! gpu_verts_reshape(out, in->len, in->layout, GPU_FLOAT, GPU_FLOAT, true)) {
+            return NULL;
+        }
+    } else if (gpu_verts_packed(in)) {
+        fprintf(stderr, "gpu_verts_transform(): Can't transform packed vertices in place\n");
+        return NULL;
+    }
+    if (! gpu_verts_copy_normals(out, in)) {
+        if (created) {
+            gpu_verts_free(out);
+        }
+        return NULL;
+    }
+    mat4 m = *mat;
+    if (in->pos_type != GPU_FLOAT) {
+        gpu_verts_decode_mat(in, mat, &m);
     }
-    for (int i = 0; i < in->len; i++) {
-        gpu_pos *po = &out->v[i].pos, *pi = &in->v[i].pos;
-        mat4_mul_vec3(mat, (float *)po, (float *)pi);
+    if (in->len < GPU_VERTS_PARALLEL) {
+        gpu_kernels_get()->transform(&m, out, in, 0, in->len);
+    } else {
+        gpu_verts_job job = {gpu_kernels_get(), &m, out, in};
+        pool_run(pool_default(), gpu_verts_transform_chunk, &job,
+                 (in->len + GPU_VERTS_CHUNK - 1) / GPU_VERTS_CHUNK);
     }
     return out;
 }
@@ -2,12 +2,50 @@
 #define GPU_VERTS_H
 
 #include <stdint.h>
+#include "enum.h"
 #include "types.h"
 #include "matrix.h"
 
+// attribute access that works for either layout
+#define gpu_verts_stream(v, stream, type, i) \
+    ((type *)((uint8_t *)(v)->stream + (size_t)(i) * (v)->stream##_stride))
+
+static inline gpu_pos *gpu_verts_pos(gpu_verts *v, uint32_t i) {
+    return gpu_verts_stream(v, pos, gpu_pos, i);
+}
+
+static inline gpu_color *gpu_verts_color(gpu_verts *v, uint32_t i) {
+    return gpu_verts_stream(v, color, gpu_color, i);
+}
+
+static inline gpu_tex_coord *gpu_verts_tex(gpu_verts *v, uint32_t i) {
+    return gpu_verts_stream(v, tex, gpu_tex_coord, i);
+}
+
+static inline gpu_pos *gpu_verts_normal(gpu_verts *v, uint32_t i) {
+    return &v->normal[i];
+}
+
+static inline bool gpu_verts_packed(const gpu_verts *v) {
+    return v->pos_type != GPU_FLOAT || v->tex_type != GPU_FLOAT;
+}
+
 gpu_verts *gpu_verts_new(uint32_t size);
+gpu_verts *gpu_verts_new_layout(uint32_t size, uint32_t layout);
+gpu_verts *gpu_verts_new_packed(uint32_t size, uint32_t pos_type, uint32_t tex_type);
+gpu_verts *gpu_verts_wrap(gpu_vert *v, uint32_t len);
 gpu_verts *gpu_verts_copy(gpu_verts *in);
+gpu_verts *gpu_verts_ref(gpu_verts *v);
 void gpu_verts_free(gpu_verts *v);
+bool gpu_verts_resize(gpu_verts *v, uint32_t len);
+bool gpu_verts_normals(gpu_verts *v);
+bool gpu_verts_reshape(gpu_verts *v, uint32_t len, uint32_t layout,
+                       uint32_t pos_type, uint32_t tex_type, bool discard);
+void gpu_verts_decode_mat(gpu_verts *v, const mat4 *mat, mat4 *out);
+bool gpu_verts_pack(gpu_verts *out, gpu_verts *in);
+gpu_verts *gpu_verts_unpack(gpu_verts *out, gpu_verts *in);
+void gpu_verts_bounds(gpu_verts *v, gpu_bounds *out);
+bool gpu_bounds_visible(const gpu_bounds *b, const mat4 *mat, uint32_t width, uint32_t height);
 gpu_verts *gpu_verts_transform(mat4 *mat, gpu_verts *out, gpu_verts *in);
 
 #endif
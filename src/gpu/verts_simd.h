@@ -0,0 +1,114 @@
+#ifndef GPU_VERTS_SIMD_H
+#define GPU_VERTS_SIMD_H
+
+// attribute decoding shared by verts.c and the kernels. everything here is
+// static so each kernel variant gets a copy built for its instruction set.
+
+#include <string.h>
+
+#include "enum.h"
+#include "gpu_helpers.h"
+#include "vectorial/simd4f.h"
+#include "verts.h"
+
+#if defined(VECTORIAL_SSE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the kernels are specialized by inlining them with constant strides and
+// types, which gcc stops doing on its own once there are a few call sites
+#ifdef __GNUC__
+#define gpu_verts_inline static inline __attribute__((always_inline))
+#else
+#define gpu_verts_inline static inline
+#endif
+
+typedef union {
+    float f;
+    uint32_t u;
+} gpu_bits;
+
+static inline float gpu_half_to_float(uint16_t h) {
+    // the exponent rebias is a multiply by 2^112, which also normalizes
+    // denormals. inf and nan get their exponent forced back to all ones.
+    gpu_bits o = {.u = (uint32_t)(h & 0x7fff) << 13};
+    o.f *= (gpu_bits){.u = (254 - 15) << 23}.f;
+    if ((h & 0x7fff) > 0x7bff) {
+        o.u |= 255 << 23;
+    }
+    o.u |= (uint32_t)(h & 0x8000) << 16;
+    return o.f;
+}
+
+// converts the four components at p, without normalizing
+gpu_verts_inline simd4f gpu_verts_load4(const void *p, uint32_t type) {
+    switch (type) {
+    case GPU_FLOAT:
+        return simd4f_uload4(p);
+#if defined(VECTORIAL_SSE) && defined(__SSE2__)
+    case GPU_SHORT: {
+        __m128i s = _mm_loadl_epi64((const __m128i *)p);
+        return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+    }
+    case GPU_UNSIGNED_SHORT: {
+        __m128i s = _mm_loadl_epi64((const __m128i *)p);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(s, _mm_setzero_si128()));
+    }
+    case GPU_HALF_FLOAT: {
+        // gpu_half_to_float(), four lanes at a time
+        __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+        __m128i expmant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+        __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)),
+                                   _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+        __m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7bff)),
+                                       _mm_set1_epi32(255 << 23));
+        __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expmant), 16);
+        return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infnan)));
+    }
+#elif defined(VECTORIAL_NEON)
+    case GPU_SHORT:
+        return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+    case GPU_UNSIGNED_SHORT:
+        return vcvtq_f32_u32(vmovl_u16(vld1_u16(p)));
+#endif
+#if !(defined(VECTORIAL_SSE) && defined(__SSE2__))
+    case GPU_HALF_FLOAT: {
+        const uint16_t *h = p;
+        return simd4f_create(gpu_half_to_float(h[0]), gpu_half_to_float(h[1]),
+                             gpu_half_to_float(h[2]), gpu_half_to_float(h[3]));
+    }
+#endif
+    default: {
+        float f[4] = {0, 0, 0, 0};
+        GL_TYPE_SWITCH(s, p, type, {
+            f[0] = s[0]; f[1] = s[1]; f[2] = s[2]; f[3] = s[3];
+        },)
+        return simd4f_uload4(f);
+    }
+    }
+}
+
+// loads the raw x, y and z of a single position of any type, zeros for
+// unknown types
+static inline void gpu_verts_load3(const void *p, uint32_t type, float out[3]) {
+    GL_TYPE_SWITCH(s, p, type, {
+        out[0] = s[0]; out[1] = s[1]; out[2] = s[2];
+    },
+    default:
+        out[0] = out[1] = out[2] = 0;
+        break;)
+}
+
+// colors are already packed, only texture coordinates need decoding
+static inline void gpu_verts_unpack_attribs(gpu_verts *out, gpu_verts *in, uint32_t begin, uint32_t end) {
+    memcpy(out->color + begin, in->color + begin, sizeof(gpu_color) * (end - begin));
+    if (in->tex_type == GPU_FLOAT) {
+        memcpy(out->tex + begin, in->tex + begin, sizeof(gpu_tex_coord) * (end - begin));
+        return;
+    }
+    for (uint32_t i = begin; i < end; i++) {
+        simd4f_ustore4(gpu_verts_load4(gpu_verts_tex(in, i), in->tex_type), (float *)gpu_verts_tex(out, i));
+    }
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdio.h>
+
+#include "enum.h"
+#include "xform.h"
+
+static inline mat4 *gpu_xform_top(gpu_xform *xf) {
+    return &xf->current->m[xf->current->top];
+}
+
+static inline void gpu_xform_touch(gpu_xform *xf) {
+    xf->dirty |= xf->current == &xf->modelview ? GPU_XFORM_DIRTY_MODELVIEW
+                                               : GPU_XFORM_DIRTY_PROJECTION;
+}
+
+void gpu_xform_init(gpu_xform *xf) {
+    mat4_identity(&xf->modelview.m[0]);
+    mat4_identity(&xf->projection.m[0]);
+    xf->modelview.top = 0;
+    xf->projection.top = 0;
+    xf->current = &xf->modelview;
+    xf->dirty = GPU_XFORM_DIRTY_MODELVIEW | GPU_XFORM_DIRTY_PROJECTION | GPU_XFORM_DIRTY_VIEWPORT;
+    gpu_xform_viewport(xf, 0, 0, 1, 1);
+}
+
+void gpu_xform_mode(gpu_xform *xf, uint32_t mode) {
+    switch (mode) {
+    case GPU_MODELVIEW:
+        xf->current = &xf->modelview;
+        break;
+    case GPU_PROJECTION:
+        xf->current = &xf->projection;
+        break;
+    default:
+        fprintf(stderr, "gpu_xform_mode(): Unknown matrix mode 0x%x\n", mode);
+        break;
+    }
+}
+
+bool gpu_xform_push(gpu_xform *xf) {
+    gpu_matrix_stack *s = xf->current;
+    if (s->top + 1 >= GPU_XFORM_DEPTH) {
+        fprintf(stderr, "gpu_xform_push(): stack overflow\n");
+        return false;
+    }
+    s->m[s->top + 1] = s->m[s->top];
+    s->top++;
+    return true;
+}
+
+bool gpu_xform_pop(gpu_xform *xf) {
+    gpu_matrix_stack *s = xf->current;
+    if (s->top == 0) {
+        fprintf(stderr, "gpu_xform_pop(): stack underflow\n");
+        return false;
+    }
+    s->top--;
+    gpu_xform_touch(xf);
+    return true;
+}
+
+void gpu_xform_identity(gpu_xform *xf) {
+    mat4_identity(gpu_xform_top(xf));
+    gpu_xform_touch(xf);
+}
+
+void gpu_xform_load(gpu_xform *xf, const mat4 *m) {
+    *gpu_xform_top(xf) = *m;
+    gpu_xform_touch(xf);
+}
+
+void gpu_xform_mult(gpu_xform *xf, const mat4 *m) {
+    mat4_mul(gpu_xform_top(xf), (mat4 *)m);
+    gpu_xform_touch(xf);
+}
+
+void gpu_xform_translate(gpu_xform *xf, float x, float y, float z) {
+    mat4_translate(gpu_xform_top(xf), x, y, z);
+    gpu_xform_touch(xf);
+}
+
+void gpu_xform_rotate(gpu_xform *xf, float angle, float x, float y, float z) {
+    mat4_rotate(gpu_xform_top(xf), angle, x, y, z);
+    gpu_xform_touch(xf);
+}
+
+void gpu_xform_scale(gpu_xform *xf, float x, float y, float z) {
+    mat4_scale(gpu_xform_top(xf), x, y, z);
+    gpu_xform_touch(xf);
+}
+
+void gpu_xform_perspective(gpu_xform *xf, float fov, float aspect, float znear, float zfar) {
+    mat4_perspective(gpu_xform_top(xf), fov, aspect, znear, zfar);
+    gpu_xform_touch(xf);
+}
+
+// maps normalized device coordinates onto the window with y pointing down
+// the rows, and z onto a [0, 1] depth range. since the mapping is affine it
+// is folded into the combined matrix, and the vertex stage does transform,
+// divide and viewport in a single pass.
+void gpu_xform_viewport(gpu_xform *xf, int32_t x, int32_t y, uint32_t width, uint32_t height) {
+    xf->x = x;
+    xf->y = y;
+    xf->width = width;
+    xf->height = height;
+    float hw = width / 2.0f, hh = height / 2.0f;
+    mat4_identity(&xf->viewport);
+    mat4_translate(&xf->viewport, x + hw, y + hh, 0.5f);
+    mat4_scale(&xf->viewport, hw, -hh, 0.5f);
+    xf->dirty |= GPU_XFORM_DIRTY_VIEWPORT;
+}
+
+const mat4 *gpu_xform_mvp(gpu_xform *xf) {
+    if (xf->dirty & (GPU_XFORM_DIRTY_PROJECTION | GPU_XFORM_DIRTY_VIEWPORT)) {
+        xf->vp = xf->viewport;
+        mat4_mul(&xf->vp, &xf->projection.m[xf->projection.top]);
+    }
+    if (xf->dirty) {
+        xf->mvp = xf->vp;
+        mat4_mul(&xf->mvp, &xf->modelview.m[xf->modelview.top]);
+        xf->dirty = 0;
+    }
+    return &xf->mvp;
+}
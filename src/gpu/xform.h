@@ -0,0 +1,48 @@
+#ifndef GPU_XFORM_H
+#define GPU_XFORM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+#define GPU_XFORM_DEPTH 32
+
+enum {
+    GPU_XFORM_DIRTY_MODELVIEW  = 1 << 0,
+    GPU_XFORM_DIRTY_PROJECTION = 1 << 1,
+    GPU_XFORM_DIRTY_VIEWPORT   = 1 << 2,
+};
+
+typedef struct {
+    mat4 m[GPU_XFORM_DEPTH];
+    int top;
+} gpu_matrix_stack;
+
+// GL style modelview/projection stacks plus viewport. the combined matrix
+// is only rebuilt when something it depends on changed, and viewport *
+// projection is cached separately since it usually changes least.
+typedef struct {
+    gpu_matrix_stack modelview, projection;
+    gpu_matrix_stack *current;
+    int32_t x, y;
+    uint32_t width, height;
+    uint32_t dirty;
+    mat4 viewport, vp, mvp;
+} gpu_xform;
+
+void gpu_xform_init(gpu_xform *xf);
+void gpu_xform_mode(gpu_xform *xf, uint32_t mode);
+bool gpu_xform_push(gpu_xform *xf);
+bool gpu_xform_pop(gpu_xform *xf);
+void gpu_xform_identity(gpu_xform *xf);
+void gpu_xform_load(gpu_xform *xf, const mat4 *m);
+void gpu_xform_mult(gpu_xform *xf, const mat4 *m);
+void gpu_xform_translate(gpu_xform *xf, float x, float y, float z);
+void gpu_xform_rotate(gpu_xform *xf, float angle, float x, float y, float z);
+void gpu_xform_scale(gpu_xform *xf, float x, float y, float z);
+void gpu_xform_perspective(gpu_xform *xf, float fov, float aspect, float znear, float zfar);
+void gpu_xform_viewport(gpu_xform *xf, int32_t x, int32_t y, uint32_t width, uint32_t height);
+const mat4 *gpu_xform_mvp(gpu_xform *xf);
+
+#endif
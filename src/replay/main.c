@@ -0,0 +1,59 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gpu/capture.h"
+#include "gpu/frame.h"
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 1;
+    gpu_replay *replay = gpu_replay_open(argv[1]);
+    if (replay == NULL) {
+        return 1;
+    }
+
+    uint32_t frames = gpu_replay_frames(replay);
+    gpu_color *buf = NULL;
+    size_t buf_size = 0;
+    double total = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t width, height;
+        gpu_replay_size(replay, i, &width, &height);
+        if (width * height > buf_size) {
+            buf_size = width * height;
+            free(buf);
+            buf = malloc(sizeof(gpu_color) * buf_size);
+        }
+        double best = 0;
+        for (int n = 0; n < iterations; n++) {
+            gpu_frame frame = gpu_frame_init(buf, width, height);
+            double start = now();
+            gpu_replay_frame(replay, i, &frame);
+            double elapsed = now() - start;
+            gpu_frame_free(&frame);
+            if (n == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+        total += best;
+        printf("frame %u: %ux%u %.3fms\n", i, width, height, best * 1000.0);
+    }
+    printf("%u frames, %.3fms total\n", frames, total * 1000.0);
+
+    free(buf);
+    gpu_replay_close(replay);
+    return 0;
+}
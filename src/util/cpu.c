@@ -0,0 +1,74 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_X86
+#endif
+
+static const char *names[CPU_LEVELS] = {
+#if defined(CPU_X86) && defined(__SSE2__)
+    [CPU_BASE] = "sse2",
+#else
+    [CPU_BASE] = "base",
+#endif
+    [CPU_SSE41] = "sse4.1",
+    [CPU_AVX2] = "avx2",
+    [CPU_AVX512] = "avx512",
+};
+
+const char *cpu_level_name(int level) {
+    return level >= 0 && level < CPU_LEVELS ? names[level] : "unknown";
+}
+
+// the best level this CPU (and OS, for the wider registers) supports
+int cpu_detect() {
+#ifdef CPU_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("fma")) {
+        return CPU_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CPU_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return CPU_SSE41;
+    }
+#endif
+    return CPU_BASE;
+}
+
+static int level;
+
+static void cpu_level_init() {
+    level = cpu_detect();
+    const char *env = getenv("LIBGPU_CPU");
+    if (env == NULL) {
+        return;
+    }
+    for (int i = 0; i < CPU_LEVELS; i++) {
+        if (strcmp(env, names[i]) == 0 || (i == CPU_BASE && strcmp(env, "base") == 0)) {
+            if (i > level) {
+                fprintf(stderr, "cpu_level(): LIBGPU_CPU=%s is not supported here, using %s\n", env, names[level]);
+            } else {
+                level = i;
+            }
+            return;
+        }
+    }
+    fprintf(stderr, "cpu_level(): Unknown LIBGPU_CPU=%s, using %s\n", env, names[level]);
+}
+
+// detected once, then capped by LIBGPU_CPU if it is set. kernels are
+// picked from this, so the override is how variants get compared.
+int cpu_level() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, cpu_level_init);
+    return level;
+}
@@ -0,0 +1,18 @@
+#ifndef CPU_H
+#define CPU_H
+
+// instruction set levels kernels are built for, in increasing order. base
+// is whatever the rest of the library is compiled for (SSE2 on x86-64).
+enum {
+    CPU_BASE,
+    CPU_SSE41,
+    CPU_AVX2,
+    CPU_AVX512,
+    CPU_LEVELS,
+};
+
+extern int cpu_detect();
+extern int cpu_level();
+extern const char *cpu_level_name(int level);
+
+#endif
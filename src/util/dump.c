@@ -0,0 +1,243 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+#include "gpu_helpers.h"
+#include "pixel.h"
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t width, height, format, type;
+    uint64_t sequence;
+} dump_slot;
+
+struct dump {
+    char *dir, *prefix;
+    dump_format format;
+    dump_policy policy;
+    size_t slot_size;
+    dump_slot *slots;
+    uint32_t len;
+    pthread_t thread;
+    // serializes dump_frame() callers, so the slot one of them is filling
+    // stays out of the writer's way until it's queued
+    pthread_mutex_t frame;
+    pthread_mutex_t lock;
+    pthread_cond_t queued, written;
+    // slots [tail, tail + count) hold queued frames, oldest first. the
+    // writer only frees a slot once its frame is on disk.
+    uint32_t tail, count;
+    uint64_t sequence, dropped;
+    bool quit;
+    // conversion buffer, only touched by the writer
+    void *rgb;
+    size_t rgb_size;
+};
+
+// frees everything but the thread and its locks
+static void dump_release(dump_t *dump) {
+    for (uint32_t i = 0; i < dump->len; i++) {
+        free(dump->slots[i].buf);
+    }
+    free(dump->slots);
+    free(dump->rgb);
+    free(dump->prefix);
+    free(dump->dir);
+    free(dump);
+}
+
+static void dump_write(dump_t *dump, dump_slot *slot) {
+    uint32_t format = dump->format == DUMP_PAM ? GL_RGBA : GL_RGB;
+    size_t size = (size_t)slot->width * slot->height * gl_pixel_sizeof(format, GL_UNSIGNED_BYTE);
+    const void *out = slot->buf;
+    if (slot->format != format || slot->type != GL_UNSIGNED_BYTE) {
+        if (dump->rgb_size < size) {
+            free(dump->rgb);
+            dump->rgb = malloc(size);
+            dump->rgb_size = dump->rgb ? size : 0;
+        }
+        // large frames would otherwise take over the shared pool, which
+        // the render thread needs for its own transforms and conversions
+        static const pixel_options_t serial = {.serial = true};
+        if (! dump->rgb || ! pixel_convert_rect(slot->buf, NULL, slot->width, slot->height,
+                                                slot->format, slot->type, dump->rgb, 0,
+                                                format, GL_UNSIGNED_BYTE, &serial)) {
+            fprintf(stderr, "dump_write(): Can't convert frame %llu\n", (unsigned long long)slot->sequence);
+            return;
+        }
+        out = dump->rgb;
+    }
+
+    char path[4096];
+    int len = snprintf(path, sizeof(path), "%s/%s.%06llu.%s", dump->dir, dump->prefix,
+                       (unsigned long long)slot->sequence, dump->format == DUMP_PAM ? "pam" : "ppm");
+    if (len < 0 || len >= sizeof(path)) {
+        fprintf(stderr, "dump_write(): Path too long in %s\n", dump->dir);
+        return;
+    }
+    FILE *fd = fopen(path, "wb");
+    if (fd == NULL) {
+        fprintf(stderr, "dump_write(): Can't open %s\n", path);
+        return;
+    }
+    if (dump->format == DUMP_PAM) {
+        fprintf(fd, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                slot->width, slot->height);
+    } else {
+        fprintf(fd, "P6 %u %u 255\n", slot->width, slot->height);
+    }
+    if (fwrite(out, 1, size, fd) != size) {
+        fprintf(stderr, "dump_write(): Short write to %s\n", path);
+    }
+    fclose(fd);
+}
+
+static void *dump_worker(void *arg) {
+    dump_t *dump = arg;
+    pthread_mutex_lock(&dump->lock);
+    for (;;) {
+        while (! dump->quit && dump->count == 0) {
+            pthread_cond_wait(&dump->queued, &dump->lock);
+        }
+        if (dump->count == 0) {
+            break;
+        }
+        dump_slot *slot = &dump->slots[dump->tail];
+        pthread_mutex_unlock(&dump->lock);
+        dump_write(dump, slot);
+        pthread_mutex_lock(&dump->lock);
+        dump->tail = (dump->tail + 1) % dump->len;
+        dump->count--;
+        pthread_cond_broadcast(&dump->written);
+    }
+    pthread_mutex_unlock(&dump->lock);
+    return NULL;
+}
+
+dump_t *dump_new(const dump_config *config) {
+    if (config->slots == 0 || config->slot_size == 0) {
+        fprintf(stderr, "dump_new(): Need at least one slot of some size\n");
+        return NULL;
+    }
+    dump_t *dump = calloc(1, sizeof(dump_t));
+    if (dump == NULL) {
+        fprintf(stderr, "dump_new(): Out of memory\n");
+        return NULL;
+    }
+    dump->dir = strdup(config->dir ? config->dir : ".");
+    dump->prefix = strdup(config->prefix ? config->prefix : "frame");
+    dump->format = config->format;
+    dump->policy = config->policy;
+    dump->slot_size = config->slot_size;
+    dump->slots = calloc(config->slots, sizeof(dump_slot));
+    if (! dump->dir || ! dump->prefix || ! dump->slots) {
+        fprintf(stderr, "dump_new(): Out of memory\n");
+        dump_release(dump);
+        return NULL;
+    }
+    for (; dump->len < config->slots; dump->len++) {
+        dump->slots[dump->len].buf = malloc(config->slot_size);
+        if (dump->slots[dump->len].buf == NULL) {
+            fprintf(stderr, "dump_new(): Out of memory for %u slots of %zu bytes\n",
+                    config->slots, config->slot_size);
+            dump_release(dump);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&dump->frame, NULL);
+    pthread_mutex_init(&dump->lock, NULL);
+    pthread_cond_init(&dump->queued, NULL);
+    pthread_cond_init(&dump->written, NULL);
+    if (pthread_create(&dump->thread, NULL, dump_worker, dump) != 0) {
+        fprintf(stderr, "dump_new(): Can't start the writer thread\n");
+        pthread_cond_destroy(&dump->written);
+        pthread_cond_destroy(&dump->queued);
+        pthread_mutex_destroy(&dump->lock);
+        pthread_mutex_destroy(&dump->frame);
+        dump_release(dump);
+        return NULL;
+    }
+    return dump;
+}
+
+bool dump_frame(dump_t *dump, const void *pixels, uint32_t width, uint32_t height,
+                size_t pitch, uint32_t format, uint32_t type) {
+    size_t row = (size_t)width * gl_pixel_sizeof(format, type);
+    if (row == 0 || height == 0) {
+        return false;
+    }
+    if (row * height > dump->slot_size) {
+        fprintf(stderr, "dump_frame(): %ux%u frame doesn't fit %zu byte slots\n",
+                width, height, dump->slot_size);
+        return false;
+    }
+    pitch = pitch ? pitch : row;
+
+    pthread_mutex_lock(&dump->frame);
+    pthread_mutex_lock(&dump->lock);
+    uint64_t sequence = dump->sequence++;
+    if (dump->count == dump->len && dump->policy == DUMP_DROP) {
+        dump->dropped++;
+        pthread_mutex_unlock(&dump->lock);
+        pthread_mutex_unlock(&dump->frame);
+        return false;
+    }
+    while (dump->count == dump->len) {
+        pthread_cond_wait(&dump->written, &dump->lock);
+    }
+    dump_slot *slot = &dump->slots[(dump->tail + dump->count) % dump->len];
+    pthread_mutex_unlock(&dump->lock);
+
+    // the slot is past the queued ones, so the writer won't look at it
+    // until it's counted in
+    for (uint32_t y = 0; y < height; y++) {
+        memcpy(slot->buf + y * row, (const uint8_t *)pixels + y * pitch, row);
+    }
+    slot->width = width;
+    slot->height = height;
+    slot->format = format;
+    slot->type = type;
+    slot->sequence = sequence;
+
+    pthread_mutex_lock(&dump->lock);
+    dump->count++;
+    pthread_cond_signal(&dump->queued);
+    pthread_mutex_unlock(&dump->lock);
+    pthread_mutex_unlock(&dump->frame);
+    return true;
+}
+
+void dump_flush(dump_t *dump) {
+    pthread_mutex_lock(&dump->lock);
+    while (dump->count) {
+        pthread_cond_wait(&dump->written, &dump->lock);
+    }
+    pthread_mutex_unlock(&dump->lock);
+}
+
+uint64_t dump_dropped(dump_t *dump) {
+    pthread_mutex_lock(&dump->lock);
+    uint64_t dropped = dump->dropped;
+    pthread_mutex_unlock(&dump->lock);
+    return dropped;
+}
+
+void dump_free(dump_t *dump) {
+    if (dump == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&dump->lock);
+    dump->quit = true;
+    pthread_cond_signal(&dump->queued);
+    pthread_mutex_unlock(&dump->lock);
+    pthread_join(dump->thread, NULL);
+    pthread_cond_destroy(&dump->written);
+    pthread_cond_destroy(&dump->queued);
+    pthread_mutex_destroy(&dump->lock);
+    pthread_mutex_destroy(&dump->frame);
+    dump_release(dump);
+}
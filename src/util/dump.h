@@ -0,0 +1,46 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    DUMP_PPM, // P6, RGB
+    DUMP_PAM, // P7, RGB_ALPHA
+} dump_format;
+
+typedef enum {
+    // dump_frame() waits for a free slot
+    DUMP_BLOCK,
+    // dump_frame() drops the frame when every slot is taken
+    DUMP_DROP,
+} dump_policy;
+
+typedef struct {
+    // files go to <dir>/<prefix>.<sequence>.ppm (or .pam)
+    const char *dir, *prefix;
+    // the ring holds slots frames of up to slot_size bytes each
+    uint32_t slots;
+    size_t slot_size;
+    dump_format format;
+    dump_policy policy;
+} dump_config;
+
+typedef struct dump dump_t;
+
+// frames are copied into a ring of buffers allocated up front, and a
+// background thread converts and writes them out in order
+extern dump_t *dump_new(const dump_config *config);
+// queues a frame of pixels in any format pixel_convert() reads, with rows
+// pitch bytes apart (0 for tightly packed). returns false if the frame
+// doesn't fit a slot or was dropped.
+extern bool dump_frame(dump_t *dump, const void *pixels, uint32_t width, uint32_t height,
+                       size_t pitch, uint32_t format, uint32_t type);
+// waits until every queued frame is written
+extern void dump_flush(dump_t *dump);
+extern uint64_t dump_dropped(dump_t *dump);
+// writes out the queued frames and stops the thread
+extern void dump_free(dump_t *dump);
+
+#endif
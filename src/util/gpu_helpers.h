@@ -41,6 +41,8 @@ static const GLsizei gl_sizeof(GLenum type) {
         case GL_3_BYTES:
             return 3;
         case GL_LUMINANCE_ALPHA:
+        case GL_HALF_FLOAT:
+        case GL_SHORT:
         case GL_UNSIGNED_SHORT:
         case GL_UNSIGNED_SHORT_1_5_5_5_REV:
         case GL_UNSIGNED_SHORT_4_4_4_4:
@@ -51,6 +53,7 @@ static const GLsizei gl_sizeof(GLenum type) {
         case GL_2_BYTES:
             return 2;
         case GL_LUMINANCE:
+        case GL_BYTE:
         case GL_UNSIGNED_BYTE:
         case GL_UNSIGNED_BYTE_2_3_3_REV:
         case GL_UNSIGNED_BYTE_3_3_2:
@@ -105,18 +108,22 @@ static const GLsizei gl_pixel_sizeof(GLenum format, GLenum type) {
         case GL_ALPHA:
         case GL_LUMINANCE:
         case GL_RED:
+        case GL_SLUMINANCE:
             width = 1;
             break;
         case GL_LUMINANCE_ALPHA:
         case GL_RG:
+        case GL_SLUMINANCE_ALPHA:
             width = 2;
             break;
         case GL_RGB:
         case GL_BGR:
+        case GL_SRGB:
             width = 3;
             break;
         case GL_RGBA:
         case GL_BGRA:
+        case GL_SRGB_ALPHA:
             width = 4;
             break;
         default:
@@ -88,3 +88,110 @@ void mat4_mul_vec4(mat4 *m, float out[4], const float in[4]) {
     simd4x4f_matrix_vector_mul(m, &vert, &tmp);
     simd4f_ustore4(tmp, out);
 }
+
+#ifdef __GNUC__
+#define mat4_prefetch(p) __builtin_prefetch(p)
+#else
+#define mat4_prefetch(p) (void)(p)
+#endif
+
+// elements prefetched ahead of the one being transformed. the address is
+// only formed while it is still inside the array.
+#define MAT4_PREFETCH 8
+
+typedef enum { MAT4_POINT, MAT4_VECTOR, MAT4_VEC4 } mat4_kind;
+
+// one loop for all three vector kinds, the kind folds away once inlined
+static inline void mat4_mul_stream(mat4 *m, float *out, size_t out_stride,
+                                   const float *in, size_t in_stride,
+                                   size_t count, mat4_kind kind) {
+    size_t size = (kind == MAT4_VEC4) ? 16 : 12;
+    if (! in_stride) in_stride = size;
+    if (! out_stride) out_stride = size;
+    const simd4x4f mat = *m;
+    const char *src = (const char *)in;
+    char *dst = (char *)out;
+    // a 16 byte load of a vec3 reads into the next element, so only the
+    // last one needs the narrow load; stores must never clobber input
+    size_t wide = (in_stride >= 16 || count == 0) ? count : count - 1;
+    for (size_t i = 0; i < count; i++) {
+        if (i + MAT4_PREFETCH < count) {
+            mat4_prefetch(src + MAT4_PREFETCH * in_stride);
+        }
+        simd4f v, r;
+        if (kind == MAT4_VEC4 || i < wide) {
+            v = simd4f_uload4((const float *)src);
+        } else {
+            v = simd4f_uload3((const float *)src);
+        }
+        switch (kind) {
+            case MAT4_POINT:
+                simd4x4f_matrix_point3_mul(&mat, &v, &r);
+                break;
+            case MAT4_VECTOR:
+                simd4x4f_matrix_vector3_mul(&mat, &v, &r);
+                break;
+            default:
+                simd4x4f_matrix_vector_mul(&mat, &v, &r);
+                break;
+        }
+        if (kind == MAT4_VEC4) {
+            simd4f_ustore4(r, (float *)dst);
+        } else {
+            simd4f_ustore3(r, (float *)dst);
+        }
+        src += in_stride;
+        dst += out_stride;
+    }
+}
+
+void mat4_mul_points(mat4 *m, float *out, size_t out_stride, const float *in, size_t in_stride, size_t count) {
+    mat4_mul_stream(m, out, out_stride, in, in_stride, count, MAT4_POINT);
+}
+
+void mat4_mul_vectors(mat4 *m, float *out, size_t out_stride, const float *in, size_t in_stride, size_t count) {
+    mat4_mul_stream(m, out, out_stride, in, in_stride, count, MAT4_VECTOR);
+}
+
+void mat4_mul_vec4s(mat4 *m, float *out, size_t out_stride, const float *in, size_t in_stride, size_t count) {
+    mat4_mul_stream(m, out, out_stride, in, in_stride, count, MAT4_VEC4);
+}
+
+void mat4_mul_array(mat4 *m, mat4 *out, const mat4 *in, size_t count) {
+    const simd4x4f mat = *m;
+    for (size_t i = 0; i < count; i++) {
+        if (i + MAT4_PREFETCH < count) {
+            mat4_prefetch(&in[i + MAT4_PREFETCH]);
+        }
+        simd4x4f src = in[i];
+        simd4x4f_matrix_mul(&mat, &src, &out[i]);
+    }
+}
+
+void mat4_array_mul(mat4 *out, const mat4 *in, mat4 *m, size_t count) {
+    const simd4x4f mat = *m;
+    for (size_t i = 0; i < count; i++) {
+        if (i + MAT4_PREFETCH < count) {
+            mat4_prefetch(&in[i + MAT4_PREFETCH]);
+        }
+        simd4x4f src = in[i];
+        simd4x4f_matrix_mul(&src, &mat, &out[i]);
+    }
+}
+
+void mat4_inverse_array(mat4 *out, const mat4 *in, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (i + MAT4_PREFETCH < count) {
+            mat4_prefetch(&in[i + MAT4_PREFETCH]);
+        }
+        simd4x4f src = in[i];
+        simd4x4f_inverse(&src, &out[i]);
+    }
+}
+
+void mat4_transpose_array(mat4 *out, const mat4 *in, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        simd4x4f src = in[i];
+        simd4x4f_transpose(&src, &out[i]);
+    }
+}
@@ -1,6 +1,8 @@
 #ifndef GPU_MATRIX_H
 #define GPU_MATRIX_H
 
+#include <stddef.h>
+
 #include "vectorial/simd4f.h"
 #include "vectorial/simd4x4f.h"
 
@@ -23,4 +25,16 @@ void mat4_mul_vec2(mat4 *m, float out[2], const float in[2]);
 void mat4_mul_vec3(mat4 *m, float out[3], const float in[3]);
 void mat4_mul_vec4(mat4 *m, float out[4], const float in[4]);
 
+// array forms: strides are in bytes, 0 means tightly packed
+// points get w = 1 and vectors w = 0, neither is divided by w
+void mat4_mul_points(mat4 *m, float *out, size_t out_stride, const float *in, size_t in_stride, size_t count);
+void mat4_mul_vectors(mat4 *m, float *out, size_t out_stride, const float *in, size_t in_stride, size_t count);
+void mat4_mul_vec4s(mat4 *m, float *out, size_t out_stride, const float *in, size_t in_stride, size_t count);
+// out[i] = m * in[i], out may alias in
+void mat4_mul_array(mat4 *m, mat4 *out, const mat4 *in, size_t count);
+// out[i] = in[i] * m, out may alias in
+void mat4_array_mul(mat4 *out, const mat4 *in, mat4 *m, size_t count);
+void mat4_inverse_array(mat4 *out, const mat4 *in, size_t count);
+void mat4_transpose_array(mat4 *out, const mat4 *in, size_t count);
+
 #endif
@@ -1,10 +1,23 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "pixel.h"
+#include "pixel_kernels.h"
 #include "gpu_helpers.h"
 #include "gpu_str.h"
+#include "pool.h"
+#include "resample.h"
+#include "srgb.h"
+
+// images of at least PIXEL_PARALLEL pixels are split into bands of whole
+// rows, about PIXEL_BAND pixels each, for the worker pool
+#define PIXEL_BAND (64 * 1024)
+#define PIXEL_PARALLEL (4 * PIXEL_BAND)
 
 static const colorlayout_t *get_color_map(uint32_t format) {
     #define map(fmt, ...)                               \
@@ -21,6 +34,10 @@ static const colorlayout_t *get_color_map(uint32_t format) {
         map(GL_RG, 0, 1, -1, -1);
         map(GL_RGB, 0, 1, 2, -1);
         map(GL_RGBA, 0, 1, 2, 3);
+        map(GL_SLUMINANCE, 0, 0, 0, -1, true);
+        map(GL_SLUMINANCE_ALPHA, 0, 0, 0, 1, true);
+        map(GL_SRGB, 0, 1, 2, -1, true);
+        map(GL_SRGB_ALPHA, 0, 1, 2, 3, true);
         default:
             fprintf(stderr, "get_color_map(): Unsupported pixel format %s\n", gl_str(format));
             break;
@@ -30,6 +47,124 @@ static const colorlayout_t *get_color_map(uint32_t format) {
     #undef map
 }
 
+bool pixel_format_srgb(uint32_t format) {
+    return get_color_map(format)->srgb;
+}
+
+// the format with the same layout and no transfer curve, for conversions
+// where the bytes don't change
+static uint32_t pixel_format_linear(uint32_t format) {
+    switch (format) {
+        case GL_SLUMINANCE: return GL_LUMINANCE;
+        case GL_SLUMINANCE_ALPHA: return GL_LUMINANCE_ALPHA;
+        case GL_SRGB: return GL_RGB;
+        case GL_SRGB_ALPHA: return GL_RGBA;
+    }
+    return format;
+}
+
+// components of a format go into the fields of a packed type in order
+static const pixel_packing *get_packing(uint32_t type) {
+    static const pixel_packing p332 = {{3, 3, 2, 0}, {5, 2, 0, 0}};
+    static const pixel_packing p233_rev = {{3, 3, 2, 0}, {0, 3, 6, 0}};
+    static const pixel_packing p565 = {{5, 6, 5, 0}, {11, 5, 0, 0}};
+    static const pixel_packing p565_rev = {{5, 6, 5, 0}, {0, 5, 11, 0}};
+    static const pixel_packing p4444 = {{4, 4, 4, 4}, {12, 8, 4, 0}};
+    static const pixel_packing p4444_rev = {{4, 4, 4, 4}, {0, 4, 8, 12}};
+    static const pixel_packing p5551 = {{5, 5, 5, 1}, {11, 6, 1, 0}};
+    static const pixel_packing p1555_rev = {{5, 5, 5, 1}, {0, 5, 10, 15}};
+    static const pixel_packing p1010102 = {{10, 10, 10, 2}, {22, 12, 2, 0}};
+    static const pixel_packing p2101010_rev = {{10, 10, 10, 2}, {0, 10, 20, 30}};
+    switch (type) {
+        case GL_UNSIGNED_BYTE_3_3_2: return &p332;
+        case GL_UNSIGNED_BYTE_2_3_3_REV: return &p233_rev;
+        case GL_UNSIGNED_SHORT_5_6_5: return &p565;
+        case GL_UNSIGNED_SHORT_5_6_5_REV: return &p565_rev;
+        case GL_UNSIGNED_SHORT_4_4_4_4: return &p4444;
+        case GL_UNSIGNED_SHORT_4_4_4_4_REV: return &p4444_rev;
+        case GL_UNSIGNED_SHORT_5_5_5_1: return &p5551;
+        case GL_UNSIGNED_SHORT_1_5_5_5_REV: return &p1555_rev;
+        case GL_UNSIGNED_INT_10_10_10_2: return &p1010102;
+        case GL_UNSIGNED_INT_2_10_10_10_REV: return &p2101010_rev;
+    }
+    return NULL;
+}
+
+// norm[bits][n] is n / (2^bits - 1), exactly as the float path divides,
+// for every field width a packed type has, and for bytes
+#define PIXEL_NORM_BITS 10
+static float pixel_norm[PIXEL_NORM_BITS + 1][1 << PIXEL_NORM_BITS];
+
+// byte to byte tables for pixel_convert_srgb8(): sRGB to linear and back,
+// each what the float path would store, and the bytes as they are, all 0
+// and all 255
+static const srgb_tables_t *srgb;
+static uint8_t srgb_decode8[256], srgb_encode8[256];
+static uint8_t byte_same[256], byte_zero[256], byte_one[256];
+
+static void pixel_norm_init() {
+    for (uint32_t bits = 1; bits <= PIXEL_NORM_BITS; bits++) {
+        float max = (1 << bits) - 1;
+        for (uint32_t n = 0; n < (1 << bits); n++) {
+            pixel_norm[bits][n] = n / max;
+        }
+    }
+    srgb = srgb_tables();
+    for (uint32_t n = 0; n < 256; n++) {
+        srgb_decode8[n] = (uint8_t)(srgb->to_linear[n] * 255.0);
+        srgb_encode8[n] = srgb_encode(srgb, pixel_norm[8][n]);
+        byte_same[n] = n;
+        byte_one[n] = 255;
+    }
+}
+
+// the fields of packed pixel v, normalized, in component order. missing
+// fields read as 1, like a missing alpha.
+static inline void unpack_fields(uint32_t v, const pixel_packing *packing, float f[4]) {
+    for (int c = 0; c < 4; c++) {
+        uint32_t bits = packing->bits[c];
+        f[c] = bits ? pixel_norm[bits][(v >> packing->shift[c]) & ((1 << bits) - 1)] : 1.0f;
+    }
+}
+
+// byte tables for the packed types of up to 16 bits, built on first use.
+// entry v is pixel v as 4 bytes in component order, each what the float
+// path would store for it, and 255 for missing fields.
+static const uint8_t *get_lut(uint32_t type) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static struct {
+        uint32_t type;
+        uint8_t *lut;
+    } luts[] = {
+        {GL_UNSIGNED_BYTE_3_3_2}, {GL_UNSIGNED_BYTE_2_3_3_REV},
+        {GL_UNSIGNED_SHORT_5_6_5}, {GL_UNSIGNED_SHORT_5_6_5_REV},
+        {GL_UNSIGNED_SHORT_4_4_4_4}, {GL_UNSIGNED_SHORT_4_4_4_4_REV},
+        {GL_UNSIGNED_SHORT_5_5_5_1}, {GL_UNSIGNED_SHORT_1_5_5_5_REV},
+    };
+    for (size_t i = 0; i < sizeof(luts) / sizeof(luts[0]); i++) {
+        if (luts[i].type != type) {
+            continue;
+        }
+        pthread_mutex_lock(&lock);
+        if (luts[i].lut == NULL) {
+            const pixel_packing *packing = get_packing(type);
+            uint32_t len = 1 << (8 * gl_sizeof(type));
+            uint8_t *lut = malloc(len * 4);
+            for (uint32_t v = 0; lut && v < len; v++) {
+                float f[4];
+                unpack_fields(v, packing, f);
+                for (int c = 0; c < 4; c++) {
+                    lut[v * 4 + c] = f[c] * 255.0;
+                }
+            }
+            luts[i].lut = lut;
+        }
+        pthread_mutex_unlock(&lock);
+        return luts[i].lut;
+    }
+    return NULL;
+}
+
 static inline
 bool remap_pixel(const void *src, void *dst,
                  const colorlayout_t *src_color, uint32_t src_type,
@@ -56,12 +191,36 @@ bool remap_pixel(const void *src, void *dst,
         pixel.b = default(s, amod, vmod, src_color->blue, 0);     \
         pixel.a = default(s, amod, vmod, src_color->alpha, 1.0f);
 
+    #define norm_each(bits, amod, key, def) \
+        key >= 0 ? pixel_norm[bits][s[amod key]] : def
+
+    #define read_norm(bits, amod)                                \
+        pixel.r = norm_each(bits, amod, src_color->red, 0);      \
+        pixel.g = norm_each(bits, amod, src_color->green, 0);    \
+        pixel.b = norm_each(bits, amod, src_color->blue, 0);     \
+        pixel.a = norm_each(bits, amod, src_color->alpha, 1.0f);
+
     #define write_each(amod, vmod)                         \
         carefully(d, amod, dst_color->red, pixel.r vmod)   \
         carefully(d, amod, dst_color->green, pixel.g vmod) \
         carefully(d, amod, dst_color->blue, pixel.b vmod)  \
         carefully(d, amod, dst_color->alpha, pixel.a vmod)
 
+    #define decode_each(key, def) \
+        key >= 0 ? srgb->to_linear[s[key]] : def
+
+    #define read_srgb()                                   \
+        pixel.r = decode_each(src_color->red, 0);         \
+        pixel.g = decode_each(src_color->green, 0);       \
+        pixel.b = decode_each(src_color->blue, 0);        \
+        pixel.a = norm_each(8, , src_color->alpha, 1.0f);
+
+    #define write_srgb()                                                  \
+        carefully(d, , dst_color->red, srgb_encode(srgb, pixel.r))        \
+        carefully(d, , dst_color->green, srgb_encode(srgb, pixel.g))      \
+        carefully(d, , dst_color->blue, srgb_encode(srgb, pixel.b))       \
+        carefully(d, , dst_color->alpha, pixel.a * 255.0)
+
     // this pixel stores our intermediate color
     // it will be RGBA and normalized to between (0.0 - 1.0f)
     pixel_t pixel;
@@ -69,45 +228,47 @@ bool remap_pixel(const void *src, void *dst,
         type_case(GL_DOUBLE, double, read_each(,))
         type_case(GL_FLOAT, float, read_each(,))
         case GL_UNSIGNED_INT_8_8_8_8_REV:
-        type_case(GL_UNSIGNED_BYTE, uint8_t, read_each(, / 255.0f))
-        type_case(GL_UNSIGNED_INT_8_8_8_8, uint8_t, read_each(3 - , / 255.0f))
-        type_case(GL_UNSIGNED_SHORT_4_4_4_4, uint16_t,
-            s = (uint16_t[]){
-                (v >> 0)  & 0x0f,
-                (v >> 4)  & 0x0f,
-                (v >> 8)  & 0x0f,
-                (v >> 12) & 0x0f,
-            };
-            read_each(, / 15.0f);
-        )
-        type_case(GL_UNSIGNED_SHORT_5_5_5_1, uint16_t,
-            s = (uint16_t[]){
-                ((v & 0x8000) >> 15) * 31,
-                ((v & 0x7c00) >> 10),
-                ((v & 0x03e0) >> 5),
-                v & 31,
-            };
-            read_each(, / 31.0f);
+        type_case(GL_UNSIGNED_BYTE, uint8_t,
+            if (src_color->srgb) {
+                read_srgb()
+            } else {
+                read_norm(8, )
+            }
         )
-        type_case(GL_UNSIGNED_SHORT_1_5_5_5_REV, uint16_t,
-            s = (uint16_t[]){
-                v & 31,
-                ((v & 0x03e0) >> 5),
-                ((v & 0x7c00) >> 10),
-                ((v & 0x8000) >> 15) * 31,
-            };
-            read_each(, / 31.0f);
-        )
-        default:
-            // TODO: add glSetError?
-            fprintf(stderr, "remap_pixel(): Unsupported source data type: %s\n", gl_str(src_type));
-            return false;
+        type_case(GL_UNSIGNED_INT_8_8_8_8, uint8_t, read_norm(8, 3 - ))
+        default: {
+            const pixel_packing *packing = get_packing(src_type);
+            if (packing == NULL) {
+                // TODO: add glSetError?
+                fprintf(stderr, "remap_pixel(): Unsupported source data type: %s\n", gl_str(src_type));
+                return false;
+            }
+            uint32_t v;
+            switch (gl_sizeof(src_type)) {
+                case 1: v = *(const uint8_t *)src; break;
+                case 2: v = *(const uint16_t *)src; break;
+                default: v = *(const uint32_t *)src; break;
+            }
+            // fields have different ranges, so normalize before picking
+            float f[4];
+            unpack_fields(v, packing, f);
+            pixel.r = src_color->red >= 0 ? f[src_color->red] : 0;
+            pixel.g = src_color->green >= 0 ? f[src_color->green] : 0;
+            pixel.b = src_color->blue >= 0 ? f[src_color->blue] : 0;
+            pixel.a = src_color->alpha >= 0 ? f[src_color->alpha] : 1.0f;
             break;
+        }
     }
 
     switch (dst_type) {
         type_case(GL_FLOAT, float, write_each(,))
-        type_case(GL_UNSIGNED_BYTE, uint8_t, write_each(, * 255.0))
+        type_case(GL_UNSIGNED_BYTE, uint8_t,
+            if (dst_color->srgb) {
+                write_srgb()
+            } else {
+                write_each(, * 255.0)
+            }
+        )
         // TODO: force 565 to RGB? then we can change [4] -> 3
         type_case(GL_UNSIGNED_SHORT_5_6_5, uint16_t,
             float color[3];
@@ -125,10 +286,10 @@ bool remap_pixel(const void *src, void *dst,
             color[dst_color->blue] = pixel.b;
             color[dst_color->alpha] = pixel.a;
             // TODO: can I macro this or something? it follows a pretty strict form.
-            *d = (((uint32_t)(color[0] * 31) & 0x1f) << 0) |
-                 (((uint32_t)(color[1] * 31) & 0x1f) << 5) |
-                 (((uint32_t)(color[2] * 31) & 0x1f) << 10)  |
-                 (((uint32_t)(color[3] * 1)  & 0x01) << 15);
+            *d = (((uint32_t)(color[0] * 31) & 0x1f) << 11) |
+                 (((uint32_t)(color[1] * 31) & 0x1f) << 6) |
+                 (((uint32_t)(color[2] * 31) & 0x1f) << 1)  |
+                 (((uint32_t)(color[3] * 1)  & 0x01) << 0);
         )
        type_case(GL_UNSIGNED_SHORT_4_4_4_4, uint16_t,
             float color[4];
@@ -152,16 +313,210 @@ bool remap_pixel(const void *src, void *dst,
     #undef default
     #undef carefully
     #undef read_each
+    #undef norm_each
+    #undef read_norm
     #undef write_each
+    #undef decode_each
+    #undef read_srgb
+    #undef write_srgb
+}
+
+enum {
+    FAST_SWIZZLE32 = 1,
+    FAST_EXPAND24,
+    FAST_PACK24,
+    FAST_PACK16,
+    FAST_UNPACK16,
+};
+
+typedef struct {
+    uint32_t src_format, src_type, dst_format, dst_type;
+    uint32_t kernel;
+} fast_path_t;
+
+// every combination of two source and two destination formats
+#define fast_paths(kernel, src_a, src_b, src_type, dst_a, dst_b, dst_type) \
+    {src_a, src_type, dst_a, dst_type, kernel},                         \
+    {src_a, src_type, dst_b, dst_type, kernel},                         \
+    {src_b, src_type, dst_a, dst_type, kernel},                         \
+    {src_b, src_type, dst_b, dst_type, kernel}
+
+// conversions with a pixel_kernels fast path. each one gives the same
+// result as remap_pixel(), which handles everything else.
+static const fast_path_t fast_path_table[] = {
+    fast_paths(FAST_SWIZZLE32, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_SWIZZLE32, GL_RGBA, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_SWIZZLE32, GL_RGBA, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_EXPAND24, GL_RGB, GL_BGR, GL_UNSIGNED_BYTE, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_PACK24, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, GL_RGB, GL_BGR, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_PACK16, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, GL_RGB, GL_BGR, GL_UNSIGNED_SHORT_5_6_5),
+    fast_paths(FAST_PACK16, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, GL_RGBA, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4),
+    fast_paths(FAST_PACK16, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, GL_RGBA, GL_BGRA, GL_UNSIGNED_SHORT_5_5_5_1),
+    fast_paths(FAST_UNPACK16, GL_RGB, GL_BGR, GL_UNSIGNED_SHORT_5_6_5, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_UNPACK16, GL_RGBA, GL_BGRA, GL_UNSIGNED_SHORT_4_4_4_4, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_UNPACK16, GL_RGBA, GL_BGRA, GL_UNSIGNED_SHORT_5_5_5_1, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+    fast_paths(FAST_UNPACK16, GL_RGBA, GL_BGRA, GL_UNSIGNED_SHORT_1_5_5_5_REV, GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE),
+};
+
+#undef fast_paths
+
+// runs the conversion on a pixel_kernels fast path if there is one for it.
+// the maps come from the color layouts: byte (or field) d[c] of a dst
+// pixel is component c, found at byte (or field) s[c] of the src pixel.
+static bool pixel_convert_fast(const void *src, void *dst, uint32_t pixels,
+                               uint32_t src_format, uint32_t src_type, size_t src_stride,
+                               uint32_t dst_format, uint32_t dst_type, size_t dst_stride) {
+    const fast_path_t *path = NULL;
+    for (size_t i = 0; i < sizeof(fast_path_table) / sizeof(fast_path_table[0]); i++) {
+        const fast_path_t *p = &fast_path_table[i];
+        if (p->src_format == src_format && p->src_type == src_type &&
+            p->dst_format == dst_format && p->dst_type == dst_type) {
+            path = p;
+            break;
+        }
+    }
+    if (path == NULL || src_stride != gl_pixel_sizeof(src_format, src_type) ||
+        dst_stride != gl_pixel_sizeof(dst_format, dst_type)) {
+        return false;
+    }
+
+    const int32_t *s = &get_color_map(src_format)->red, *d = &get_color_map(dst_format)->red;
+    uint8_t map[4] = {0, 0, 0, 0};
+    for (int c = 0; c < 4; c++) {
+        if (d[c] < 0) {
+            continue;
+        }
+        if (s[c] < 0) {
+            map[d[c]] = PIXEL_MAP_ONE;
+        } else {
+            // 8_8_8_8 keeps the first component in the high byte
+            map[d[c]] = src_type == GL_UNSIGNED_INT_8_8_8_8 ? 3 - s[c] : s[c];
+        }
+    }
+
+    const pixel_kernels *kernels = pixel_kernels_get();
+    switch (path->kernel) {
+        case FAST_SWIZZLE32:
+            kernels->swizzle32(src, dst, pixels, map);
+            break;
+        case FAST_EXPAND24:
+            kernels->expand24(src, dst, pixels, map);
+            break;
+        case FAST_PACK24:
+            kernels->pack24(src, dst, pixels, map);
+            break;
+        case FAST_PACK16:
+            kernels->pack16(src, dst, pixels, map, get_packing(dst_type));
+            break;
+        case FAST_UNPACK16:
+            kernels->unpack16(src, dst, pixels, map, get_packing(src_type));
+            break;
+    }
+    return true;
+}
+
+// packed types with a get_lut() table to bytes, a lookup per pixel
+static bool pixel_convert_lut(const void *src, void *dst, uint32_t pixels,
+                              uint32_t src_format, uint32_t src_type, size_t src_stride,
+                              uint32_t dst_format, size_t dst_stride) {
+    const uint8_t *lut = get_lut(src_type);
+    if (lut == NULL) {
+        return false;
+    }
+    // byte k of a dst pixel is byte map[k] of the entry, or of the 0 and
+    // 255 after it, picked in the order remap_pixel() writes components
+    const int32_t *s = &get_color_map(src_format)->red, *d = &get_color_map(dst_format)->red;
+    uint8_t map[4] = {4, 4, 4, 4};
+    for (int c = 0; c < 4; c++) {
+        if (d[c] >= 0) {
+            map[d[c]] = s[c] >= 0 ? s[c] : c == 3 ? 5 : 4;
+        }
+    }
+    uint32_t channels = gl_pixel_sizeof(dst_format, GL_UNSIGNED_BYTE);
+    bool wide = gl_sizeof(src_type) == 2;
+    const uint8_t *sp = src;
+    uint8_t *dp = dst;
+    for (uint32_t i = 0; i < pixels; i++, sp += src_stride, dp += dst_stride) {
+        const uint8_t *e = lut + (wide ? *(const uint16_t *)sp : *sp) * 4;
+        uint8_t px[6] = {e[0], e[1], e[2], e[3], 0, 255};
+        for (uint32_t k = 0; k < channels; k++) {
+            dp[k] = px[map[k]];
+        }
+    }
+    return true;
+}
+
+// byte to byte conversions between sRGB and linear formats, a table
+// lookup per component. alpha is never encoded.
+static void pixel_convert_srgb8(const void *src, void *dst, uint32_t pixels,
+                                uint32_t src_format, size_t src_stride,
+                                uint32_t dst_format, size_t dst_stride) {
+    // byte k of a dst pixel is table[k][byte from[k] of the src pixel],
+    // picked in the order remap_pixel() writes components
+    const colorlayout_t *src_color = get_color_map(src_format);
+    const int32_t *s = &src_color->red, *d = &get_color_map(dst_format)->red;
+    const uint8_t *table[4] = {byte_zero, byte_zero, byte_zero, byte_zero};
+    uint32_t from[4] = {0, 0, 0, 0};
+    for (int c = 0; c < 4; c++) {
+        if (d[c] < 0) {
+            continue;
+        }
+        if (s[c] < 0) {
+            table[d[c]] = c == 3 ? byte_one : byte_zero;
+            from[d[c]] = 0;
+        } else {
+            table[d[c]] = c == 3 ? byte_same : src_color->srgb ? srgb_decode8 : srgb_encode8;
+            from[d[c]] = s[c];
+        }
+    }
+    uint32_t channels = gl_pixel_sizeof(dst_format, GL_UNSIGNED_BYTE);
+    const uint8_t *sp = src;
+    uint8_t *dp = dst;
+    for (uint32_t i = 0; i < pixels; i++, sp += src_stride, dp += dst_stride) {
+        for (uint32_t k = 0; k < channels; k++) {
+            dp[k] = table[k][sp[from[k]]];
+        }
+    }
 }
 
 bool pixel_convert_direct(const void *src, void *dst, uint32_t width,
                           uint32_t src_format, uint32_t src_type, size_t src_stride,
                           uint32_t dst_format, uint32_t dst_type, size_t dst_stride) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, pixel_norm_init);
+
     const colorlayout_t *src_color, *dst_color;
     src_color = get_color_map(src_format);
     dst_color = get_color_map(dst_format);
 
+    if ((src_color->srgb && src_type != GL_UNSIGNED_BYTE) ||
+        (dst_color->srgb && dst_type != GL_UNSIGNED_BYTE)) {
+        fprintf(stderr, "pixel_convert_direct(): sRGB formats need GL_UNSIGNED_BYTE, not %s to %s\n",
+                gl_str(src_type), gl_str(dst_type));
+        return false;
+    }
+    if (src_color->srgb && dst_color->srgb) {
+        // the curve cancels out, so the bytes move like linear ones
+        src_format = pixel_format_linear(src_format);
+        dst_format = pixel_format_linear(dst_format);
+        src_color = get_color_map(src_format);
+        dst_color = get_color_map(dst_format);
+    } else if (src_color->srgb != dst_color->srgb &&
+               src_type == GL_UNSIGNED_BYTE && dst_type == GL_UNSIGNED_BYTE) {
+        pixel_convert_srgb8(src, dst, width, src_format, src_stride, dst_format, dst_stride);
+        return true;
+    }
+
+    if (pixel_convert_fast(src, dst, width, src_format, src_type, src_stride,
+                           dst_format, dst_type, dst_stride)) {
+        return true;
+    }
+    if (dst_type == GL_UNSIGNED_BYTE && src_color->type && dst_color->type && ! dst_color->srgb &&
+        pixel_convert_lut(src, dst, width, src_format, src_type, src_stride,
+                          dst_format, dst_stride)) {
+        return true;
+    }
+
     uintptr_t src_pos = (uintptr_t)src;
     uintptr_t dst_pos = (uintptr_t)dst;
     for (int i = 0; i < width; i++) {
@@ -177,60 +532,379 @@ bool pixel_convert_direct(const void *src, void *dst, uint32_t width,
     return true;
 }
 
-bool pixel_convert(const void *src, void **dst,
-                   uint32_t width, uint32_t height,
-                   uint32_t src_format, uint32_t src_type,
-                   uint32_t dst_format, uint32_t dst_type) {
-    const colorlayout_t *src_color, *dst_color;
-    uint32_t pixels = width * height;
-    uint32_t dst_size = pixels * gl_pixel_sizeof(dst_format, dst_type);
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dst;
+    uint32_t width, height, rows;
+    uint32_t src_format, src_type, dst_format, dst_type;
+    size_t src_stride, dst_stride, src_pitch, dst_pitch;
+    // dithered rows are converted to RGBA first, bytes for ordered and
+    // floats for diffused, then packed. component c goes into field[c]
+    // of the dst, or nowhere if it's negative.
+    pixel_dither dither;
+    const pixel_packing *packing;
+    int32_t field[4];
+    bool premultiply;
+    // set by any band that fails, under lock
+    pthread_mutex_t lock;
+    bool failed;
+} pixel_convert_job;
 
-    src_color = get_color_map(src_format);
-    dst_color = get_color_map(dst_format);
-    if (!dst_size || !gl_pixel_sizeof(src_format, src_type)
-        || !src_color->type || !dst_color->type)
+static inline void pixel_premultiply_float(float *rgba, uint32_t pixels) {
+    for (uint32_t i = 0; i < pixels; i++, rgba += 4) {
+        rgba[0] *= rgba[3];
+        rgba[1] *= rgba[3];
+        rgba[2] *= rgba[3];
+    }
+}
+
+// thresholds of the 8x8 Bayer matrix, in 255ths of a step
+static const uint8_t pixel_bayer[8][8] = {
+    {  1, 129,  33, 161,   9, 137,  41, 169},
+    {193,  65, 225,  97, 201,  73, 233, 105},
+    { 49, 177,  17, 145,  57, 185,  25, 153},
+    {241, 113, 209,  81, 249, 121, 217,  89},
+    { 13, 141,  45, 173,   5, 133,  37, 165},
+    {205,  77, 237, 109, 197,  69, 229, 101},
+    { 61, 189,  29, 157,  53, 181,  21, 149},
+    {253, 125, 221,  93, 245, 117, 213,  85}
+};
+
+static bool pixel_dither_ordered(const pixel_convert_job *job, uint32_t row, uint32_t rows) {
+    uint8_t *rgba = malloc((size_t)job->width * 4);
+    if (rgba == NULL) {
+        fprintf(stderr, "pixel_convert_rect(): Out of memory for a %u pixel row\n", job->width);
+        return false;
+    }
+    // unused fields have no bits, so what they pick doesn't matter
+    uint8_t map[4] = {0, 0, 0, 0};
+    for (int c = 0; c < 4; c++) {
+        if (job->field[c] >= 0) {
+            map[job->field[c]] = c;
+        }
+    }
+    const pixel_kernels *kernels = pixel_kernels_get();
+    for (uint32_t y = row; y < row + rows; y++) {
+        if (! pixel_convert_direct(job->src + y * job->src_pitch, rgba, job->width,
+                                   job->src_format, job->src_type, job->src_stride,
+                                   GL_RGBA, GL_UNSIGNED_BYTE, 4)) {
+            free(rgba);
+            return false;
+        }
+        if (job->premultiply) {
+            kernels->premultiply8(rgba, job->width, 4, 3);
+        }
+        kernels->dither16(rgba, (uint16_t *)(job->dst + y * job->dst_pitch), job->width,
+                          map, job->packing, pixel_bayer[y & 7]);
+    }
+    free(rgba);
+    return true;
+}
+
+// every pixel rounds to the nearest step and hands its error on to the
+// pixels after it, 7/16 along the row and 3/16, 5/16 and 1/16 to the row
+// below. rows alternate direction, so the error doesn't drift one way.
+static bool pixel_dither_diffuse(const pixel_convert_job *job) {
+    size_t n = (size_t)job->width * 4;
+    float *rgba = malloc(n * sizeof(float));
+    // two rows of error, with a pixel of slack on either end
+    float *err = calloc(2 * (n + 8), sizeof(float));
+    if (rgba == NULL || err == NULL) {
+        fprintf(stderr, "pixel_convert_rect(): Out of memory for a %u pixel row\n", job->width);
+        free(rgba);
+        free(err);
+        return false;
+    }
+    for (uint32_t y = 0; y < job->height; y++) {
+        if (! pixel_convert_direct(job->src + y * job->src_pitch, rgba, job->width,
+                                   job->src_format, job->src_type, job->src_stride,
+                                   GL_RGBA, GL_FLOAT, 4 * sizeof(float))) {
+            free(rgba);
+            free(err);
+            return false;
+        }
+        if (job->premultiply) {
+            pixel_premultiply_float(rgba, job->width);
+        }
+        float *cur = err + (y & 1) * (n + 8) + 4, *next = err + (~y & 1) * (n + 8) + 4;
+        memset(next - 4, 0, (n + 8) * sizeof(float));
+        uint16_t *dst = (uint16_t *)(job->dst + y * job->dst_pitch);
+        int32_t dir = y & 1 ? -4 : 4;
+        for (uint32_t i = 0; i < job->width; i++) {
+            ptrdiff_t x = (ptrdiff_t)(y & 1 ? job->width - 1 - i : i) * 4;
+            uint32_t v = 0;
+            for (int c = 0; c < 4; c++) {
+                int32_t f = job->field[c];
+                if (f < 0) {
+                    continue;
+                }
+                float max = (1 << job->packing->bits[f]) - 1;
+                float want = rgba[x + c] + cur[x + c];
+                float q = floorf(want * max + 0.5f);
+                q = q < 0 ? 0 : q > max ? max : q;
+                float e = want - q / max;
+                cur[x + dir + c] += e * (7 / 16.0f);
+                next[x - dir + c] += e * (3 / 16.0f);
+                next[x + c] += e * (5 / 16.0f);
+                next[x + dir + c] += e * (1 / 16.0f);
+                v |= (uint32_t)q << job->packing->shift[f];
+            }
+            dst[x / 4] = v;
+        }
+    }
+    free(rgba);
+    free(err);
+    return true;
+}
+
+// linear byte formats are premultiplied where they land, everything else
+// on the way there, in RGBA floats. that's linear light for sRGB.
+static bool pixel_premultiply_rows(const pixel_convert_job *job, uint32_t row, uint32_t rows) {
+    const colorlayout_t *dst_color = get_color_map(job->dst_format);
+    if (job->dst_type == GL_UNSIGNED_BYTE && ! dst_color->srgb) {
+        const pixel_kernels *kernels = pixel_kernels_get();
+        uint32_t channels = job->dst_stride;
+        for (uint32_t y = row; y < row + rows; y++) {
+            uint8_t *dst = job->dst + y * job->dst_pitch;
+            if (! pixel_convert_direct(job->src + y * job->src_pitch, dst, job->width,
+                                       job->src_format, job->src_type, job->src_stride,
+                                       job->dst_format, job->dst_type, job->dst_stride)) {
+                return false;
+            }
+            kernels->premultiply8(dst, job->width, channels, dst_color->alpha);
+        }
+        return true;
+    }
+    float *rgba = malloc((size_t)job->width * 4 * sizeof(float));
+    if (rgba == NULL) {
+        fprintf(stderr, "pixel_convert_rect(): Out of memory for a %u pixel row\n", job->width);
+        return false;
+    }
+    bool ok = true;
+    for (uint32_t y = row; ok && y < row + rows; y++) {
+        ok = pixel_convert_direct(job->src + y * job->src_pitch, rgba, job->width,
+                                  job->src_format, job->src_type, job->src_stride,
+                                  GL_RGBA, GL_FLOAT, 4 * sizeof(float));
+        if (ok) {
+            pixel_premultiply_float(rgba, job->width);
+            ok = pixel_convert_direct(rgba, job->dst + y * job->dst_pitch, job->width,
+                                      GL_RGBA, GL_FLOAT, 4 * sizeof(float),
+                                      job->dst_format, job->dst_type, job->dst_stride);
+        }
+    }
+    free(rgba);
+    return ok;
+}
+
+// converts rows [row, row + rows), in one run when neither side has
+// padding between rows
+static bool pixel_convert_rows(const pixel_convert_job *job, uint32_t row, uint32_t rows) {
+    if (job->dither == PIXEL_DITHER_ORDERED) {
+        return pixel_dither_ordered(job, row, rows);
+    }
+    if (job->premultiply) {
+        return pixel_premultiply_rows(job, row, rows);
+    }
+    const uint8_t *src = job->src + row * job->src_pitch;
+    uint8_t *dst = job->dst + row * job->dst_pitch;
+    if (job->src_pitch == job->width * job->src_stride &&
+        job->dst_pitch == job->width * job->dst_stride) {
+        return pixel_convert_direct(src, dst, rows * job->width,
+                                    job->src_format, job->src_type, job->src_stride,
+                                    job->dst_format, job->dst_type, job->dst_stride);
+    }
+    for (uint32_t y = 0; y < rows; y++) {
+        if (! pixel_convert_direct(src, dst, job->width,
+                                   job->src_format, job->src_type, job->src_stride,
+                                   job->dst_format, job->dst_type, job->dst_stride)) {
+            return false;
+        }
+        src += job->src_pitch;
+        dst += job->dst_pitch;
+    }
+    return true;
+}
+
+static void pixel_convert_band(void *ctx, uint32_t index) {
+    pixel_convert_job *job = ctx;
+    uint32_t row = index * job->rows;
+    uint32_t rows = row + job->rows < job->height ? job->rows : job->height - row;
+    if (! pixel_convert_rows(job, row, rows)) {
+        pthread_mutex_lock(&job->lock);
+        job->failed = true;
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+// bytes between rows of a width pixel wide source, following the
+// GL_UNPACK_ALIGNMENT rule that rows of components at least as large as
+// the alignment are never padded
+static size_t pixel_unpack_pitch(const pixel_unpack_t *unpack, uint32_t width,
+                                 uint32_t format, uint32_t type) {
+    size_t row = (size_t)(unpack->row_length ? unpack->row_length : width) *
+                 gl_pixel_sizeof(format, type);
+    size_t align = unpack->alignment ? unpack->alignment : 1;
+    if (gl_sizeof(type) >= align) {
+        return row;
+    }
+    return (row + align - 1) / align * align;
+}
+
+bool pixel_convert_rect(const void *src, const pixel_unpack_t *unpack,
+                        uint32_t width, uint32_t height,
+                        uint32_t src_format, uint32_t src_type,
+                        void *dst, size_t dst_pitch,
+                        uint32_t dst_format, uint32_t dst_type,
+                        const pixel_options_t *options) {
+    static const pixel_unpack_t packed = {0, 0, 0, 1};
+    static const pixel_options_t defaults = {PIXEL_DITHER_NONE, false, false};
+    if (unpack == NULL) {
+        unpack = &packed;
+    }
+    if (options == NULL) {
+        options = &defaults;
+    }
+    if (options->dither < PIXEL_DITHER_NONE || options->dither > PIXEL_DITHER_DIFFUSE) {
+        fprintf(stderr, "pixel_convert_rect(): Unknown dither mode %d\n", options->dither);
+        return false;
+    }
+    const colorlayout_t *src_color = get_color_map(src_format);
+    const colorlayout_t *dst_color = get_color_map(dst_format);
+    size_t src_stride = gl_pixel_sizeof(src_format, src_type);
+    size_t dst_stride = gl_pixel_sizeof(dst_format, dst_type);
+    if (!src_color->type || !dst_color->type || !src_stride || !dst_stride) {
+        return false;
+    }
+    switch (unpack->alignment) {
+        case 0: case 1: case 2: case 4: case 8:
+            break;
+        default:
+            fprintf(stderr, "pixel_convert_rect(): Invalid unpack alignment %u\n", unpack->alignment);
+            return false;
+    }
+    if (unpack->row_length && unpack->row_length < unpack->skip_pixels + width) {
+        fprintf(stderr, "pixel_convert_rect(): Rect of %u pixels from %u overruns row length %u\n",
+                width, unpack->skip_pixels, unpack->row_length);
+        return false;
+    }
+    if (dst_pitch == 0) {
+        dst_pitch = (size_t)width * dst_stride;
+    }
+    if (dst_pitch < (size_t)width * dst_stride) {
+        fprintf(stderr, "pixel_convert_rect(): Pitch %zu is under %u pixels\n", dst_pitch, width);
+        return false;
+    }
+    if (!width || !height) {
+        return true;
+    }
+
+    size_t src_pitch = pixel_unpack_pitch(unpack, width, src_format, src_type);
+    const uint8_t *first = (const uint8_t *)src + unpack->skip_rows * src_pitch +
+                           unpack->skip_pixels * src_stride;
+    uint8_t *out = dst;
+    // converting in place works front to back as long as every dst pixel
+    // ends before the next src pixel starts
+    const uint8_t *src_end = first + (height - 1) * src_pitch + width * src_stride;
+    const uint8_t *dst_end = out + (height - 1) * dst_pitch + width * dst_stride;
+    bool overlap = out < src_end && first < dst_end;
+    if (overlap && (dst_stride > src_stride || dst_pitch > src_pitch || out > first)) {
+        fprintf(stderr, "pixel_convert_rect(): Can't convert %s/%s to %s/%s in place\n",
+                gl_str(src_format), gl_str(src_type), gl_str(dst_format), gl_str(dst_type));
         return false;
+    }
 
-    if (src_type == dst_type && src_color->type == dst_color->type) {
-        if (*dst != src) {
-            *dst = malloc(dst_size);
-            memcpy(*dst, src, dst_size);
+    bool premultiply = options->premultiply && dst_color->alpha >= 0;
+    if (! premultiply && src_type == dst_type && src_color->type == dst_color->type) {
+        if (out == first && dst_pitch == src_pitch) {
             return true;
         }
-    } else {
-        size_t src_stride = gl_pixel_sizeof(src_format, src_type);
-        size_t dst_stride = gl_pixel_sizeof(dst_format, dst_type);
-        *dst = malloc(dst_size);
-        return pixel_convert_direct(
-            src, *dst, pixels,
-            src_format, src_type, src_stride,
-            dst_format, dst_type, dst_stride);
-    }
-    return false;
+        for (uint32_t y = 0; y < height; y++) {
+            memmove(out + y * dst_pitch, first + y * src_pitch, width * dst_stride);
+        }
+        return true;
+    }
+
+    pixel_convert_job job = {
+        first, out, width, height, 0,
+        src_format, src_type, dst_format, dst_type,
+        src_stride, dst_stride, src_pitch, dst_pitch,
+    };
+    job.premultiply = premultiply;
+    // dithering only changes how packed 16 bit fields round. rows are
+    // read in full before they're written, so it works in place too.
+    job.packing = get_packing(dst_type);
+    if (options->dither != PIXEL_DITHER_NONE && job.packing && gl_sizeof(dst_type) == 2) {
+        job.dither = options->dither;
+        const int32_t *d = &dst_color->red;
+        for (int c = 0; c < 4; c++) {
+            job.field[c] = d[c] >= 0 && job.packing->bits[d[c]] ? d[c] : -1;
+        }
+        if (job.dither == PIXEL_DITHER_DIFFUSE) {
+            return pixel_dither_diffuse(&job);
+        }
+    }
+    // bands run in any order, so in place conversions stay serial. the
+    // first pixel is converted up front, since an unsupported type fails
+    // on it regardless of the data, and every pixel is converted on its
+    // own, so this is the same as one serial run.
+    if (overlap || options->serial || (size_t)width * height < PIXEL_PARALLEL) {
+        return pixel_convert_rows(&job, 0, height);
+    }
+    uint8_t probe[4];
+    bool ok = job.dither ? pixel_convert_direct(first, probe, 1, src_format, src_type, src_stride,
+                                                GL_RGBA, GL_UNSIGNED_BYTE, 4)
+                         : pixel_convert_direct(first, out, 1, src_format, src_type, src_stride,
+                                                dst_format, dst_type, dst_stride);
+    if (! ok) {
+        return false;
+    }
+    job.rows = PIXEL_BAND / width ? PIXEL_BAND / width : 1;
+    pthread_mutex_init(&job.lock, NULL);
+    pool_run(pool_default(), pixel_convert_band, &job, (height + job.rows - 1) / job.rows);
+    pthread_mutex_lock(&job.lock);
+    ok = ! job.failed;
+    pthread_mutex_unlock(&job.lock);
+    pthread_mutex_destroy(&job.lock);
+    return ok;
+}
+
+bool pixel_convert(const void *src, void **dst,
+                   uint32_t width, uint32_t height,
+                   uint32_t src_format, uint32_t src_type,
+                   uint32_t dst_format, uint32_t dst_type) {
+    size_t dst_size = (size_t)width * height * gl_pixel_sizeof(dst_format, dst_type);
+    if (!dst_size) {
+        return false;
+    }
+    void *out = malloc(dst_size);
+    if (! out) {
+        fprintf(stderr, "pixel_convert(): Out of memory for %ux%u pixels\n", width, height);
+        return false;
+    }
+    if (! pixel_convert_rect(src, NULL, width, height, src_format, src_type,
+                             out, 0, dst_format, dst_type, NULL)) {
+        free(out);
+        return false;
+    }
+    *dst = out;
+    return true;
 }
 
 bool pixel_scale(const void *old, void **new,
                  uint32_t width, uint32_t height,
                  float ratio,
                  uint32_t format, uint32_t type) {
-    uint32_t pixel_size, new_width, new_height;
-    new_width = width * ratio;
-    new_height = height * ratio;
-    fprintf(stderr, "scaling %ux%u -> %ux%u\n", width, height, new_width, new_height);
-    void *dst;
-    uintptr_t src, pos, pixel;
-
-    pixel_size = gl_pixel_sizeof(format, type);
-    dst = malloc(pixel_size * new_width * new_height);
-    src = (uintptr_t)old;
-    pos = (uintptr_t)dst;
-    for (int x = 0; x < new_width; x++) {
-        for (int y = 0; y < new_height; y++) {
-            pixel = src + (x / ratio) +
-                          (y / ratio) * width;
-            memcpy((void *)pos, (void *)pixel, pixel_size);
-            pos += pixel_size;
-        }
+    uint32_t new_width = width * ratio, new_height = height * ratio;
+    size_t size = (size_t)gl_pixel_sizeof(format, type) * new_width * new_height;
+    void *dst = malloc(size);
+    if (! dst) {
+        fprintf(stderr, "pixel_scale(): Out of memory for %ux%u pixels\n", new_width, new_height);
+        return false;
+    }
+    if (! resample(old, width, height, 0, dst, new_width, new_height, 0,
+                   format, type, RESAMPLE_NEAREST)) {
+        free(dst);
+        return false;
     }
     *new = dst;
     return true;
@@ -241,21 +915,27 @@ bool pixel_to_ppm(const void *pixels, uint32_t width, uint32_t height,
     if (! pixels)
         return false;
 
-    const void *src;
+    void *rgb = NULL;
+    const void *src = pixels;
     char filename[64];
-    int size = 4 * 3 * width * height;
-    if (format == GL_RGB && type == GL_UNSIGNED_BYTE) {
-        src = pixels;
-    } else {
-        if (! pixel_convert(pixels, (void **)&src, width, height, format, type, GL_RGB, GL_UNSIGNED_BYTE)) {
+    size_t size = (size_t)3 * width * height;
+    if (format != GL_RGB || type != GL_UNSIGNED_BYTE) {
+        if (! pixel_convert(pixels, &rgb, width, height, format, type, GL_RGB, GL_UNSIGNED_BYTE)) {
             return false;
         }
+        src = rgb;
     }
 
     snprintf(filename, 64, "/tmp/tex.%d.ppm", name);
     FILE *fd = fopen(filename, "w");
+    if (fd == NULL) {
+        fprintf(stderr, "pixel_to_ppm(): Can't open %s\n", filename);
+        free(rgb);
+        return false;
+    }
     fprintf(fd, "P6 %d %d %d\n", width, height, 255);
     fwrite(src, 1, size, fd);
     fclose(fd);
+    free(rgb);
     return true;
 }
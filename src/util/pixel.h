@@ -7,17 +7,63 @@
 typedef struct {
     uint32_t type;
     int32_t red, green, blue, alpha;
+    // color components are sRGB encoded bytes, alpha stays linear
+    bool srgb;
 } colorlayout_t;
 
 typedef struct {
     float r, g, b, a;
 } pixel_t;
 
+// GL_UNPACK_* layout of a source image. zero row_length means rows of
+// width pixels, zero alignment means 1.
+typedef struct {
+    uint32_t row_length, skip_pixels, skip_rows, alignment;
+} pixel_unpack_t;
+
+typedef enum {
+    PIXEL_DITHER_NONE,
+    // an 8x8 Bayer matrix. it only depends on position, so large images
+    // still convert in parallel bands.
+    PIXEL_DITHER_ORDERED,
+    // serpentine Floyd-Steinberg. looks better, but runs on one thread,
+    // so it's meant for offline conversions.
+    PIXEL_DITHER_DIFFUSE,
+} pixel_dither;
+
+// per conversion settings, NULL (or all zero) for the defaults
+typedef struct {
+    // how packed 16 bit dst types round, instead of truncating
+    pixel_dither dither;
+    // multiplies color by alpha for dst formats with alpha. sRGB colors
+    // are multiplied in linear light.
+    bool premultiply;
+    // converts on the calling thread only, leaving the shared pool to
+    // whoever else needs it
+    bool serial;
+} pixel_options_t;
+
+// converts into a new tightly packed buffer, returned in *dst. *dst is
+// only written, pixel_convert_rect() converts into a caller's buffer.
 bool pixel_convert(const void *src, void **dst,
                    uint32_t width, uint32_t height,
                    uint32_t src_format, uint32_t src_type,
                    uint32_t dst_format, uint32_t dst_type);
 
+// converts a width x height rect of src, laid out as unpack says (NULL
+// for tightly packed), to dst rows dst_pitch bytes apart (0 for tightly
+// packed). dst may overlap src if its pixels and pitch are no larger and
+// it does not start after src. dither patterns start at the rect's corner.
+bool pixel_convert_rect(const void *src, const pixel_unpack_t *unpack,
+                        uint32_t width, uint32_t height,
+                        uint32_t src_format, uint32_t src_type,
+                        void *dst, size_t dst_pitch,
+                        uint32_t dst_format, uint32_t dst_type,
+                        const pixel_options_t *options);
+
+// sRGB formats only come as GL_UNSIGNED_BYTE
+bool pixel_format_srgb(uint32_t format);
+
 bool pixel_convert_direct(const void *src, void *dst, uint32_t pixels,
                           uint32_t src_format, uint32_t src_type, size_t src_stride,
                           uint32_t dst_format, uint32_t dst_type, size_t dst_stride);
@@ -27,6 +73,8 @@ bool pixel_scale(const void *src, void **dst,
                   float ratio,
                   uint32_t format, uint32_t type);
 
+// writes /tmp/tex.<name>.ppm on the calling thread, see dump.h for
+// capturing frames in the background
 bool pixel_to_ppm(const void *pixels,
                   uint32_t width, uint32_t height,
                   uint32_t format, uint32_t type, uint32_t name);
@@ -0,0 +1,24 @@
+#include "cpu.h"
+#include "pixel_kernels.h"
+
+extern const pixel_kernels pixel_kernel_table_base;
+#ifdef PIXEL_KERNELS_X86
+extern const pixel_kernels pixel_kernel_table_sse41;
+extern const pixel_kernels pixel_kernel_table_avx2;
+extern const pixel_kernels pixel_kernel_table_avx512;
+#endif
+
+// picked by cpu_level(), so LIBGPU_CPU can force a lower variant
+const pixel_kernels *pixel_kernels_get() {
+#ifdef PIXEL_KERNELS_X86
+    static const pixel_kernels *tables[CPU_LEVELS] = {
+        [CPU_BASE] = &pixel_kernel_table_base,
+        [CPU_SSE41] = &pixel_kernel_table_sse41,
+        [CPU_AVX2] = &pixel_kernel_table_avx2,
+        [CPU_AVX512] = &pixel_kernel_table_avx512,
+    };
+    return tables[cpu_level()];
+#else
+    return &pixel_kernel_table_base;
+#endif
+}
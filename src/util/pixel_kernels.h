@@ -0,0 +1,71 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_KERNELS_X86
+#endif
+
+// a map entry that stores 255 instead of picking a src byte or field
+#define PIXEL_MAP_ONE 0xff
+
+// the fields of a packed pixel, in the order the format's
+// components go into them. unused fields have 0 bits.
+typedef struct {
+    uint8_t bits[4], shift[4];
+} pixel_packing;
+
+// pixel_convert() fast paths and resample() passes, built once per
+// cpu_level() (see pixel_kernels_impl.h). byte channels convert to and
+// from packed fields exactly like the float path: scaled and truncated.
+typedef struct {
+    // byte i of every 4 byte dst pixel is byte map[i] of the src pixel.
+    // src and dst may be the same buffer.
+    void (*swizzle32)(const uint8_t *src, uint8_t *dst, size_t pixels, const uint8_t map[4]);
+    // 3 byte pixels to 4 byte ones, map[i] may be PIXEL_MAP_ONE. src and dst
+    // can't overlap.
+    void (*expand24)(const uint8_t *src, uint8_t *dst, size_t pixels, const uint8_t map[4]);
+    // 4 byte pixels to 3 byte ones, src and dst may be the same buffer
+    void (*pack24)(const uint8_t *src, uint8_t *dst, size_t pixels, const uint8_t map[3]);
+    // field i of every dst pixel comes from byte map[i] of the src pixel.
+    // src and dst may be the same buffer.
+    void (*pack16)(const uint8_t *src, uint16_t *dst, size_t pixels, const uint8_t map[4],
+                   const pixel_packing *packing);
+    // pack16 with an ordered dither: every field of pixel i is scaled to
+    // its max, offset by threshold[i & 7] / 255 of a step and truncated
+    void (*dither16)(const uint8_t *src, uint16_t *dst, size_t pixels, const uint8_t map[4],
+                     const pixel_packing *packing, const uint8_t threshold[8]);
+    // multiplies the other bytes of every pixel of channels bytes by its
+    // byte at alpha, over 255 and rounded, in place
+    void (*premultiply8)(uint8_t *px, size_t pixels, uint32_t channels, uint32_t alpha);
+    // byte i of every dst pixel comes from field map[i] of the src pixel, or
+    // is 255 for PIXEL_MAP_ONE. src and dst can't overlap.
+    void (*unpack16)(const uint16_t *src, uint8_t *dst, size_t pixels, const uint8_t map[4],
+                     const pixel_packing *packing);
+
+    // the resample() passes. pixels are channels components, bytes or
+    // floats, and the passes in between always work in floats.
+
+    // a row of a horizontal pass: dst pixel i is the sum of the taps src
+    // pixels from start[i], weighted by weight[i * taps + t]
+    void (*resample_h)(const void *src, bool bytes, float *dst, uint32_t width, uint32_t channels,
+                       const uint32_t *start, const float *weight, uint32_t taps);
+    // a row of a vertical pass: the sum of taps rows of n floats, pitch
+    // floats apart, weighted by weight[t]. bytes are rounded and clamped.
+    void (*resample_v)(const float *src, size_t pitch, const float *weight, uint32_t taps,
+                       void *dst, bool bytes, size_t n);
+    // a row of 2x2 box averages, rounded. a and b are src rows of
+    // 2 * width pixels.
+    void (*halve8)(const uint8_t *a, const uint8_t *b, uint8_t *dst, uint32_t width, uint32_t channels);
+    // a row of a 2x bilinear upscale, 2 * width pixels from the nearest src
+    // row, weighted 3/4, and the other one it falls between
+    void (*double8)(const uint8_t *near, const uint8_t *far, uint8_t *dst, uint32_t width,
+                    uint32_t channels);
+} pixel_kernels;
+
+const pixel_kernels *pixel_kernels_get();
+
+#endif
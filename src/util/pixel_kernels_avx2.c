@@ -0,0 +1,9 @@
+#include "pixel_kernels.h"
+
+#ifdef PIXEL_KERNELS_X86
+#ifndef __AVX2__
+#error "pixel_kernels_avx2.c must be built with -mavx2 -mfma"
+#endif
+#define PIXEL_KERNELS_SUFFIX avx2
+#include "pixel_kernels_impl.h"
+#endif
@@ -0,0 +1,9 @@
+#include "pixel_kernels.h"
+
+#ifdef PIXEL_KERNELS_X86
+#ifndef __AVX512BW__
+#error "pixel_kernels_avx512.c must be built with -mavx512f -mavx512bw -mavx512vl"
+#endif
+#define PIXEL_KERNELS_SUFFIX avx512
+#include "pixel_kernels_impl.h"
+#endif
@@ -0,0 +1,2 @@
+#define PIXEL_KERNELS_SUFFIX base
+#include "pixel_kernels_impl.h"
@@ -0,0 +1,582 @@
+// included once per instruction set level by the pixel_kernels_*.c files,
+// each of which is compiled with its own -m flags and defines
+// PIXEL_KERNELS_SUFFIX. the intrinsics picked below follow from those flags.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pixel_kernels.h"
+#include "vectorial/simd8f.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#define KERNEL_NAME_(name, suffix) pixel_kernel_##name##_##suffix
+#define KERNEL_NAME(name, suffix) KERNEL_NAME_(name, suffix)
+#define KERNEL(name) KERNEL_NAME(name, PIXEL_KERNELS_SUFFIX)
+
+// the float path scales by max / 255.0f and truncates, which for bytes is
+// exactly this
+static inline uint32_t pixel_unorm_pack(uint32_t v, uint32_t max) {
+    uint32_t x = v * max;
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+// and in the other direction it computes n / max * 255.0 in floating
+// point, which isn't always floor(n * 255 / max). these multiply-high
+// constants reproduce it for every n, indexed by field width.
+static const struct {
+    uint16_t mul, shift;
+} pixel_unorm_magic[9] = {
+    [4] = {4370, 0},
+    [5] = {8457, 2},
+    [6] = {8323, 3},
+};
+
+static inline uint32_t pixel_unorm_unpack(uint32_t n, uint32_t bits) {
+    uint32_t x = n * 255;
+    if (bits == 1) {
+        return x;
+    }
+    return ((x * pixel_unorm_magic[bits].mul) >> 16) >> pixel_unorm_magic[bits].shift;
+}
+
+static void KERNEL(swizzle32)(const uint8_t *src, uint8_t *dst, size_t pixels, const uint8_t map[4]) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // pshufb works within 16 byte lanes, which hold four whole pixels
+    uint8_t lane[16];
+    for (int k = 0; k < 16; k++) {
+        lane[k] = (k & ~3) + map[k & 3];
+    }
+    __m128i shuf = _mm_loadu_si128((const __m128i *)lane);
+#if defined(__AVX512BW__)
+    __m512i shuf512 = _mm512_broadcast_i32x4(shuf);
+    for (; i + 16 <= pixels; i += 16) {
+        __m512i p = _mm512_loadu_si512(src + i * 4);
+        _mm512_storeu_si512(dst + i * 4, _mm512_shuffle_epi8(p, shuf512));
+    }
+    if (i < pixels) {
+        __mmask64 mask = ((uint64_t)1 << ((pixels - i) * 4)) - 1;
+        __m512i p = _mm512_maskz_loadu_epi8(mask, src + i * 4);
+        _mm512_mask_storeu_epi8(dst + i * 4, mask, _mm512_shuffle_epi8(p, shuf512));
+        i = pixels;
+    }
+#elif defined(__AVX2__)
+    __m256i shuf256 = _mm256_broadcastsi128_si256(shuf);
+    for (; i + 8 <= pixels; i += 8) {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+        _mm256_storeu_si256((__m256i *)(dst + i * 4), _mm256_shuffle_epi8(p, shuf256));
+    }
+#endif
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_shuffle_epi8(p, shuf));
+    }
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4), o;
+        for (int c = 0; c < 4; c++) {
+            o.val[c] = p.val[map[c]];
+        }
+        vst4q_u8(dst + i * 4, o);
+    }
+#endif
+    for (; i < pixels; i++) {
+        uint8_t p[4];
+        memcpy(p, src + i * 4, 4);
+        dst[i * 4 + 0] = p[map[0]];
+        dst[i * 4 + 1] = p[map[1]];
+        dst[i * 4 + 2] = p[map[2]];
+        dst[i * 4 + 3] = p[map[3]];
+    }
+}
+
+static void KERNEL(expand24)(const uint8_t *src, uint8_t *dst, size_t pixels, const uint8_t map[4]) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // four pixels per 16 byte load, the last 4 bytes of which are unused.
+    // bytes taking PIXEL_MAP_ONE are zeroed by the shuffle and then set.
+    uint8_t lane[16], one[16];
+    for (int k = 0; k < 16; k++) {
+        bool set = map[k & 3] == PIXEL_MAP_ONE;
+        lane[k] = set ? 0x80 : 3 * (k >> 2) + map[k & 3];
+        one[k] = set ? 0xff : 0;
+    }
+    __m128i shuf = _mm_loadu_si128((const __m128i *)lane);
+    __m128i ones = _mm_loadu_si128((const __m128i *)one);
+    for (; i * 3 + 16 <= pixels * 3; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(p, shuf), ones));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x3_t p = vld3q_u8(src + i * 3);
+        uint8x16x4_t o;
+        for (int c = 0; c < 4; c++) {
+            o.val[c] = map[c] == PIXEL_MAP_ONE ? vdupq_n_u8(0xff) : p.val[map[c]];
+        }
+        vst4q_u8(dst + i * 4, o);
+    }
+#endif
+    for (; i < pixels; i++) {
+        const uint8_t *p = src + i * 3;
+        for (int c = 0; c < 4; c++) {
+            dst[i * 4 + c] = map[c] == PIXEL_MAP_ONE ? 0xff : p[map[c]];
+        }
+    }
+}
+
+static void KERNEL(pack24)(const uint8_t *src, uint8_t *dst, size_t pixels, const uint8_t map[3]) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // each 16 byte store carries four pixels and 4 bytes of zeroes, which
+    // the next store overwrites. stores stay behind the loads, so this
+    // works in place.
+    uint8_t lane[16];
+    for (int k = 0; k < 16; k++) {
+        lane[k] = k < 12 ? 4 * (k / 3) + map[k % 3] : 0x80;
+    }
+    __m128i shuf = _mm_loadu_si128((const __m128i *)lane);
+    for (; i * 3 + 16 <= pixels * 3; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dst + i * 3), _mm_shuffle_epi8(p, shuf));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4);
+        uint8x16x3_t o;
+        for (int c = 0; c < 3; c++) {
+            o.val[c] = p.val[map[c]];
+        }
+        vst3q_u8(dst + i * 3, o);
+    }
+#endif
+    for (; i < pixels; i++) {
+        uint8_t p[4];
+        memcpy(p, src + i * 4, 4);
+        dst[i * 3 + 0] = p[map[0]];
+        dst[i * 3 + 1] = p[map[1]];
+        dst[i * 3 + 2] = p[map[2]];
+    }
+}
+
+static void KERNEL(pack16)(const uint8_t *src, uint16_t *dst, size_t pixels, const uint8_t map[4],
+                           const pixel_packing *packing) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // bytes are shuffled into field order and widened to 16 bits, scaled
+    // with a multiply and the divide by 255, and moved into place with
+    // another multiply. the fields of a pixel have no bits in common, so
+    // summing them (madd, then hadd) packs the pixel.
+    uint8_t lane[16];
+    uint16_t scale[8], place[8], low[16];
+    for (int k = 0; k < 16; k++) {
+        lane[k] = packing->bits[k & 3] ? (k & ~3) + map[k & 3] : 0x80;
+        low[k] = k < 8 ? (k / 2) * 4 + (k & 1) : 0x80;
+    }
+    for (int k = 0; k < 8; k++) {
+        uint32_t bits = packing->bits[k & 3];
+        scale[k] = (1 << bits) - 1;
+        place[k] = bits ? 1 << packing->shift[k & 3] : 0;
+    }
+    __m128i shuf = _mm_loadu_si128((const __m128i *)lane);
+    __m128i scales = _mm_loadu_si128((const __m128i *)scale);
+    __m128i places = _mm_loadu_si128((const __m128i *)place);
+    __m128i pick = _mm_packus_epi16(_mm_loadu_si128((const __m128i *)low),
+                                    _mm_loadu_si128((const __m128i *)(low + 8)));
+    __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i p = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i * 4)), shuf);
+        __m128i half[2] = {_mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero)};
+        for (int h = 0; h < 2; h++) {
+            __m128i x = _mm_mullo_epi16(half[h], scales);
+            x = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8)), 8);
+            half[h] = _mm_madd_epi16(_mm_mullo_epi16(x, places), one);
+        }
+        __m128i px = _mm_shuffle_epi8(_mm_hadd_epi32(half[0], half[1]), pick);
+        _mm_storel_epi64((__m128i *)(dst + i), px);
+    }
+#endif
+    for (; i < pixels; i++) {
+        const uint8_t *p = src + i * 4;
+        uint32_t v = 0;
+        for (int f = 0; f < 4; f++) {
+            if (packing->bits[f]) {
+                v |= pixel_unorm_pack(p[map[f]], (1 << packing->bits[f]) - 1) << packing->shift[f];
+            }
+        }
+        dst[i] = v;
+    }
+}
+
+static void KERNEL(dither16)(const uint8_t *src, uint16_t *dst, size_t pixels, const uint8_t map[4],
+                             const pixel_packing *packing, const uint8_t threshold[8]) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // pack16 with the thresholds added before the divide by 255. four
+    // pixels go at a time, so the thresholds of pixels 0-3 and 4-7 take
+    // turns, two pixels to a vector.
+    uint8_t lane[16];
+    uint16_t scale[8], place[8], low[16], offset[4][8];
+    for (int k = 0; k < 16; k++) {
+        lane[k] = packing->bits[k & 3] ? (k & ~3) + map[k & 3] : 0x80;
+        low[k] = k < 8 ? (k / 2) * 4 + (k & 1) : 0x80;
+    }
+    for (int k = 0; k < 8; k++) {
+        uint32_t bits = packing->bits[k & 3];
+        scale[k] = (1 << bits) - 1;
+        place[k] = bits ? 1 << packing->shift[k & 3] : 0;
+        for (int h = 0; h < 4; h++) {
+            offset[h][k] = threshold[h * 2 + k / 4];
+        }
+    }
+    __m128i shuf = _mm_loadu_si128((const __m128i *)lane);
+    __m128i scales = _mm_loadu_si128((const __m128i *)scale);
+    __m128i places = _mm_loadu_si128((const __m128i *)place);
+    __m128i offsets[4];
+    for (int h = 0; h < 4; h++) {
+        offsets[h] = _mm_loadu_si128((const __m128i *)offset[h]);
+    }
+    __m128i pick = _mm_packus_epi16(_mm_loadu_si128((const __m128i *)low),
+                                    _mm_loadu_si128((const __m128i *)(low + 8)));
+    __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i p = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i * 4)), shuf);
+        __m128i half[2] = {_mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero)};
+        for (int h = 0; h < 2; h++) {
+            __m128i x = _mm_add_epi16(_mm_mullo_epi16(half[h], scales), offsets[(i & 4) / 2 + h]);
+            x = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8)), 8);
+            half[h] = _mm_madd_epi16(_mm_mullo_epi16(x, places), one);
+        }
+        __m128i px = _mm_shuffle_epi8(_mm_hadd_epi32(half[0], half[1]), pick);
+        _mm_storel_epi64((__m128i *)(dst + i), px);
+    }
+#endif
+    for (; i < pixels; i++) {
+        const uint8_t *p = src + i * 4;
+        uint32_t v = 0;
+        for (int f = 0; f < 4; f++) {
+            if (packing->bits[f]) {
+                uint32_t x = p[map[f]] * ((1 << packing->bits[f]) - 1) + threshold[i & 7];
+                v |= ((x + 1 + (x >> 8)) >> 8) << packing->shift[f];
+            }
+        }
+        dst[i] = v;
+    }
+}
+
+static void KERNEL(premultiply8)(uint8_t *px, size_t pixels, uint32_t channels, uint32_t alpha) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // alpha is spread over the bytes of its pixel, except itself, which
+    // is scaled by 255 and so stays put
+    if (channels == 4) {
+        uint8_t lane[16], keep[16];
+        for (int k = 0; k < 16; k++) {
+            lane[k] = (k & 3) == alpha ? 0x80 : (k & ~3) + alpha;
+            keep[k] = (k & 3) == alpha ? 0xff : 0;
+        }
+        __m128i spread = _mm_loadu_si128((const __m128i *)lane);
+        __m128i kept = _mm_loadu_si128((const __m128i *)keep);
+        __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16(128);
+        for (; i + 4 <= pixels; i += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i *)(px + i * 4));
+            __m128i a = _mm_or_si128(_mm_shuffle_epi8(p, spread), kept);
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi8(a, zero)), half);
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi8(a, zero)), half);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128((__m128i *)(px + i * 4), _mm_packus_epi16(lo, hi));
+        }
+    }
+#endif
+    for (; i < pixels; i++) {
+        uint8_t *p = px + i * channels;
+        uint32_t a = p[alpha];
+        for (uint32_t k = 0; k < channels; k++) {
+            if (k != alpha) {
+                uint32_t x = p[k] * a + 128;
+                p[k] = (x + (x >> 8)) >> 8;
+            }
+        }
+    }
+}
+
+static void KERNEL(unpack16)(const uint16_t *src, uint8_t *dst, size_t pixels, const uint8_t map[4],
+                             const pixel_packing *packing) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // eight pixels at a time: every field is pulled out and expanded to a
+    // byte in a vector of its own, then the four are interleaved into
+    // pixels and shuffled into dst order
+    uint8_t lane[16], one[16];
+    for (int k = 0; k < 16; k++) {
+        bool set = map[k & 3] == PIXEL_MAP_ONE;
+        lane[k] = set ? 0x80 : (k & ~3) + map[k & 3];
+        one[k] = set ? 0xff : 0;
+    }
+    __m128i shuf = _mm_loadu_si128((const __m128i *)lane);
+    __m128i ones = _mm_loadu_si128((const __m128i *)one);
+    __m128i mask[4], mul[4], shift[4], post[4];
+    for (int f = 0; f < 4; f++) {
+        uint32_t bits = packing->bits[f];
+        mask[f] = _mm_set1_epi16((1 << bits) - 1);
+        mul[f] = _mm_set1_epi16(pixel_unorm_magic[bits].mul);
+        shift[f] = _mm_cvtsi32_si128(packing->shift[f]);
+        post[f] = _mm_cvtsi32_si128(pixel_unorm_magic[bits].shift);
+    }
+    __m128i k255 = _mm_set1_epi16(255);
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i field[4];
+        for (int f = 0; f < 4; f++) {
+            uint32_t bits = packing->bits[f];
+            __m128i x = _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi16(v, shift[f]), mask[f]), k255);
+            if (bits > 1) {
+                x = _mm_srl_epi16(_mm_mulhi_epu16(x, mul[f]), post[f]);
+            } else if (bits == 0) {
+                x = _mm_setzero_si128();
+            }
+            field[f] = x;
+        }
+        __m128i ab = _mm_packus_epi16(field[0], field[1]);
+        __m128i cd = _mm_packus_epi16(field[2], field[3]);
+        ab = _mm_unpacklo_epi8(ab, _mm_srli_si128(ab, 8));
+        cd = _mm_unpacklo_epi8(cd, _mm_srli_si128(cd, 8));
+        __m128i lo = _mm_shuffle_epi8(_mm_unpacklo_epi16(ab, cd), shuf);
+        __m128i hi = _mm_shuffle_epi8(_mm_unpackhi_epi16(ab, cd), shuf);
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_or_si128(lo, ones));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 16), _mm_or_si128(hi, ones));
+    }
+#endif
+    for (; i < pixels; i++) {
+        uint8_t field[4];
+        for (int f = 0; f < 4; f++) {
+            uint32_t bits = packing->bits[f];
+            field[f] = bits ? pixel_unorm_unpack((src[i] >> packing->shift[f]) & ((1 << bits) - 1), bits) : 0;
+        }
+        for (int c = 0; c < 4; c++) {
+            dst[i * 4 + c] = map[c] == PIXEL_MAP_ONE ? 0xff : field[map[c]];
+        }
+    }
+}
+
+// the components of a 4 channel pixel as floats
+static inline simd4f pixel_load4(const void *p, bool bytes) {
+    if (! bytes) {
+        return simd4f_uload4(p);
+    }
+#if defined(VECTORIAL_SSE) && defined(__SSE2__)
+    int32_t v;
+    memcpy(&v, p, 4);
+    __m128i zero = _mm_setzero_si128();
+    __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero));
+#else
+    const uint8_t *b = p;
+    return simd4f_create(b[0], b[1], b[2], b[3]);
+#endif
+}
+
+static inline float pixel_load1(const void *p, size_t i, bool bytes) {
+    return bytes ? ((const uint8_t *)p)[i] : ((const float *)p)[i];
+}
+
+static inline uint8_t pixel_round8(float v) {
+    return v <= 0 ? 0 : v >= 255 ? 255 : (uint8_t)(v + 0.5f);
+}
+
+static void KERNEL(resample_h)(const void *src, bool bytes, float *dst, uint32_t width, uint32_t channels,
+                               const uint32_t *start, const float *weight, uint32_t taps) {
+    size_t size = bytes ? 1 : sizeof(float);
+    if (channels == 4) {
+        // two taps per simd8f, one pixel in each half, which are added
+        // together at the end. two dst pixels are summed side by side so
+        // the multiply-adds don't all wait on each other.
+        for (uint32_t i = 0; i < width; i += 2) {
+            uint32_t n = i + 1 < width ? 2 : 1;
+            simd8f acc[2] = {simd8f_zero(), simd8f_zero()};
+            uint32_t t = 0;
+            for (; t + 2 <= taps; t += 2) {
+                for (uint32_t k = 0; k < n; k++) {
+                    const uint8_t *p = (const uint8_t *)src + ((size_t)start[i + k] + t) * 4 * size;
+                    const float *w = weight + (size_t)(i + k) * taps + t;
+                    simd8f px = bytes ? simd8f_combine(pixel_load4(p, true), pixel_load4(p + 4, true))
+                                      : simd8f_uload8((const float *)p);
+                    acc[k] = simd8f_madd(px, simd8f_combine(simd4f_splat(w[0]), simd4f_splat(w[1])), acc[k]);
+                }
+            }
+            for (uint32_t k = 0; k < n; k++) {
+                simd4f sum = simd4f_add(simd8f_get_low(acc[k]), simd8f_get_high(acc[k]));
+                if (t < taps) {
+                    const uint8_t *p = (const uint8_t *)src + ((size_t)start[i + k] + t) * 4 * size;
+                    sum = simd4f_madd(pixel_load4(p, bytes), simd4f_splat(weight[(size_t)(i + k) * taps + t]), sum);
+                }
+                simd4f_ustore4(sum, dst + (i + k) * 4);
+            }
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < width; i++) {
+        const float *w = weight + (size_t)i * taps;
+        for (uint32_t c = 0; c < channels; c++) {
+            float sum = 0;
+            for (uint32_t t = 0; t < taps; t++) {
+                sum += pixel_load1(src, ((size_t)start[i] + t) * channels + c, bytes) * w[t];
+            }
+            dst[i * channels + c] = sum;
+        }
+    }
+}
+
+static void KERNEL(resample_v)(const float *src, size_t pitch, const float *weight, uint32_t taps,
+                               void *dst, bool bytes, size_t n) {
+    size_t i = 0;
+    // 32 floats at a time, in four independent sums, then 8 at a time
+    for (; i + 8 <= n; ) {
+        simd8f acc[4] = {simd8f_zero(), simd8f_zero(), simd8f_zero(), simd8f_zero()};
+        uint32_t lanes = i + 32 <= n ? 4 : 1;
+        if (lanes == 4) {
+            for (uint32_t t = 0; t < taps; t++) {
+                const float *p = src + t * pitch + i;
+                simd8f w = simd8f_splat(weight[t]);
+                acc[0] = simd8f_madd(simd8f_uload8(p), w, acc[0]);
+                acc[1] = simd8f_madd(simd8f_uload8(p + 8), w, acc[1]);
+                acc[2] = simd8f_madd(simd8f_uload8(p + 16), w, acc[2]);
+                acc[3] = simd8f_madd(simd8f_uload8(p + 24), w, acc[3]);
+            }
+        } else {
+            for (uint32_t t = 0; t < taps; t++) {
+                acc[0] = simd8f_madd(simd8f_uload8(src + t * pitch + i), simd8f_splat(weight[t]), acc[0]);
+            }
+        }
+        for (uint32_t k = 0; k < lanes; k++, i += 8) {
+            if (! bytes) {
+                simd8f_ustore8(acc[k], (float *)dst + i);
+                continue;
+            }
+#if defined(VECTORIAL_SSE) && defined(__SSE2__)
+            // clamped, then rounded half up by truncating, like pixel_round8()
+            __m128i q[2];
+            for (int h = 0; h < 2; h++) {
+                simd4f v = h ? simd8f_get_high(acc[k]) : simd8f_get_low(acc[k]);
+                v = simd4f_min(simd4f_max(v, simd4f_zero()), simd4f_splat(255));
+                q[h] = _mm_cvttps_epi32(simd4f_add(v, simd4f_splat(0.5f)));
+            }
+            __m128i w = _mm_packs_epi32(q[0], q[1]);
+            _mm_storel_epi64((__m128i *)((uint8_t *)dst + i), _mm_packus_epi16(w, w));
+#else
+            float v[8];
+            simd8f_ustore8(acc[k], v);
+            for (int c = 0; c < 8; c++) {
+                ((uint8_t *)dst)[i + c] = pixel_round8(v[c]);
+            }
+#endif
+        }
+    }
+    for (; i < n; i++) {
+        float sum = 0;
+        for (uint32_t t = 0; t < taps; t++) {
+            sum += src[t * pitch + i] * weight[t];
+        }
+        if (bytes) {
+            ((uint8_t *)dst)[i] = pixel_round8(sum);
+        } else {
+            ((float *)dst)[i] = sum;
+        }
+    }
+}
+
+static void KERNEL(halve8)(const uint8_t *a, const uint8_t *b, uint8_t *dst, uint32_t width, uint32_t channels) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    if (channels == 4) {
+        // four src pixels of each row widened to shorts and summed, then
+        // the sums of neighbouring pixels added, two dst pixels at a time
+        __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+        for (; i + 2 <= width; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i * 8));
+            __m128i y = _mm_loadu_si128((const __m128i *)(b + i * 8));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            _mm_storel_epi64((__m128i *)(dst + i * 4), _mm_packus_epi16(sum, sum));
+        }
+    }
+#endif
+    for (; i < width; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            size_t l = (size_t)i * 2 * channels + c, r = l + channels;
+            dst[i * channels + c] = (a[l] + a[r] + b[l] + b[r] + 2) >> 2;
+        }
+    }
+}
+
+// dst pixels 2i and 2i + 1, which lean 3/4 on src pixel i and 1/4 on the
+// one before or after it
+static inline void pixel_double8(const uint8_t *near, const uint8_t *far, uint8_t *dst, uint32_t i,
+                                 uint32_t width, uint32_t channels) {
+    uint32_t l = i ? i - 1 : 0, r = i + 1 < width ? i + 1 : i;
+    for (uint32_t c = 0; c < channels; c++) {
+        uint32_t v = 3 * near[i * channels + c] + far[i * channels + c];
+        uint32_t vl = 3 * near[l * channels + c] + far[l * channels + c];
+        uint32_t vr = 3 * near[r * channels + c] + far[r * channels + c];
+        dst[(size_t)i * 2 * channels + c] = (3 * v + vl + 8) >> 4;
+        dst[((size_t)i * 2 + 1) * channels + c] = (3 * v + vr + 8) >> 4;
+    }
+}
+
+static void KERNEL(double8)(const uint8_t *near, const uint8_t *far, uint8_t *dst, uint32_t width,
+                            uint32_t channels) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    if (channels == 4 && width > 2) {
+        // src pixels i and i + 1 at a time, next to both their neighbours.
+        // the vertical blend is done for each, then the horizontal one.
+        pixel_double8(near, far, dst, i++, width, channels);
+        __m128i zero = _mm_setzero_si128(), eight = _mm_set1_epi16(8);
+        for (; i + 2 < width; i += 2) {
+            __m128i v[3];
+            for (int k = 0; k < 3; k++) {
+                __m128i n = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(near + (i + k - 1) * 4)), zero);
+                __m128i f = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(far + (i + k - 1) * 4)), zero);
+                v[k] = _mm_add_epi16(_mm_add_epi16(n, _mm_add_epi16(n, n)), f);
+            }
+            __m128i mid = _mm_add_epi16(_mm_add_epi16(v[1], _mm_add_epi16(v[1], v[1])), eight);
+            // even holds dst pixels 2i and 2i + 2, odd 2i + 1 and 2i + 3
+            __m128i even = _mm_srli_epi16(_mm_add_epi16(mid, v[0]), 4);
+            __m128i odd = _mm_srli_epi16(_mm_add_epi16(mid, v[2]), 4);
+            _mm_storeu_si128((__m128i *)(dst + i * 8),
+                             _mm_packus_epi16(_mm_unpacklo_epi64(even, odd), _mm_unpackhi_epi64(even, odd)));
+        }
+    }
+#endif
+    for (; i < width; i++) {
+        pixel_double8(near, far, dst, i, width, channels);
+    }
+}
+
+const pixel_kernels KERNEL(table) = {
+    .swizzle32 = KERNEL(swizzle32),
+    .expand24 = KERNEL(expand24),
+    .pack24 = KERNEL(pack24),
+    .pack16 = KERNEL(pack16),
+    .dither16 = KERNEL(dither16),
+    .premultiply8 = KERNEL(premultiply8),
+    .unpack16 = KERNEL(unpack16),
+    .resample_h = KERNEL(resample_h),
+    .resample_v = KERNEL(resample_v),
+    .halve8 = KERNEL(halve8),
+    .double8 = KERNEL(double8),
+};
+
+#undef KERNEL_NAME_
+#undef KERNEL_NAME
+#undef KERNEL
@@ -0,0 +1,9 @@
+#include "pixel_kernels.h"
+
+#ifdef PIXEL_KERNELS_X86
+#ifndef __SSE4_1__
+#error "pixel_kernels_sse41.c must be built with -msse4.1"
+#endif
+#define PIXEL_KERNELS_SUFFIX sse41
+#include "pixel_kernels_impl.h"
+#endif
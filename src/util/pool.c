@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define POOL_MAX_THREADS 64
+
+struct pool {
+    pthread_t *threads;
+    int len;
+    // serializes pool_run() callers, only one job is in flight at a time
+    pthread_mutex_t run;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+    // the current job. workers claim indices under lock, and a new job is
+    // only posted once every index of the last one has finished.
+    pool_fn fn;
+    void *ctx;
+    uint32_t count, next, finished;
+    uint64_t generation;
+    bool quit;
+};
+
+// claims and runs indices until the job is exhausted. called with lock held.
+static void pool_work(pool_t *pool) {
+    while (pool->next < pool->count) {
+        uint32_t index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->ctx, index);
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->finished == pool->count) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+}
+
+static void *pool_worker(void *arg) {
+    pool_t *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    uint64_t seen = pool->generation;
+    for (;;) {
+        while (! pool->quit && pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        seen = pool->generation;
+        pool_work(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// threads counts the calling thread, which always helps out in pool_run()
+pool_t *pool_new(int threads) {
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > POOL_MAX_THREADS) {
+        threads = POOL_MAX_THREADS;
+    }
+    pool_t *pool = calloc(1, sizeof(pool_t));
+    pthread_mutex_init(&pool->run, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->threads = calloc(threads - 1, sizeof(pthread_t));
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&pool->threads[pool->len], NULL, pool_worker, pool) != 0) {
+            fprintf(stderr, "pool_new(): Could only start %d of %d threads\n", i + 1, threads);
+            break;
+        }
+        pool->len++;
+    }
+    return pool;
+}
+
+static pool_t *default_pool;
+
+static void pool_default_init() {
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("LIBGPU_THREADS");
+    if (env) {
+        threads = atoi(env);
+    }
+    default_pool = pool_new(threads);
+}
+
+// shared by the whole library, sized to the online CPUs unless
+// LIBGPU_THREADS says otherwise
+pool_t *pool_default() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, pool_default_init);
+    return default_pool;
+}
+
+int pool_threads(pool_t *pool) {
+    return pool->len + 1;
+}
+
+// runs fn over every index and returns once all of them are done. fn must
+// not call pool_run() on the same pool.
+void pool_run(pool_t *pool, pool_fn fn, void *ctx, uint32_t count) {
+    if (pool->len == 0 || count <= 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            fn(ctx, i);
+        }
+        return;
+    }
+    pthread_mutex_lock(&pool->run);
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->count = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pool_work(pool);
+    while (pool->finished < pool->count) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run);
+}
+
+void pool_free(pool_t *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->len; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,17 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+
+// called once for every index in [0, count), from any of the pool's threads
+typedef void (*pool_fn)(void *ctx, uint32_t index);
+
+typedef struct pool pool_t;
+
+extern pool_t *pool_new(int threads);
+extern pool_t *pool_default();
+extern int pool_threads(pool_t *pool);
+extern void pool_run(pool_t *pool, pool_fn fn, void *ctx, uint32_t count);
+extern void pool_free(pool_t *pool);
+
+#endif
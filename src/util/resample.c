@@ -0,0 +1,307 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resample.h"
+#include "gpu_helpers.h"
+#include "gpu_str.h"
+#include "pixel_kernels.h"
+#include "pool.h"
+
+// images of at least RESAMPLE_PARALLEL pixels are split into bands of
+// whole rows, about RESAMPLE_BAND pixels each, for the worker pool
+#define RESAMPLE_BAND (64 * 1024)
+#define RESAMPLE_PARALLEL (4 * RESAMPLE_BAND)
+
+#define RESAMPLE_PI 3.14159265358979323846
+
+// the taps src pixels every dst pixel along one axis is made of, from
+// start[i], weighted by weight[i * taps + t]
+typedef struct {
+    uint32_t taps;
+    uint32_t *start;
+    float *weight;
+} resample_axis;
+
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dst;
+    uint32_t src_width, src_height, dst_width, dst_height;
+    size_t src_pitch, dst_pitch;
+    uint32_t pixel_size, channels, rows;
+    bool bytes;
+    // nearest: the src offset of every dst column
+    const size_t *column;
+    // filtered: the horizontal pass goes to tmp, dst_width x src_height
+    resample_axis x, y;
+    float *tmp;
+} resample_job;
+
+static double filter_box(double x) {
+    return x >= -0.5 && x < 0.5;
+}
+
+static double filter_triangle(double x) {
+    x = fabs(x);
+    return x < 1 ? 1 - x : 0;
+}
+
+static double sinc(double x) {
+    if (x == 0) {
+        return 1;
+    }
+    x *= RESAMPLE_PI;
+    return sin(x) / x;
+}
+
+static double filter_lanczos3(double x) {
+    return x > -3 && x < 3 ? sinc(x) * sinc(x / 3) : 0;
+}
+
+static const struct {
+    double (*fn)(double x);
+    double support;
+} filters[] = {
+    [RESAMPLE_BILINEAR] = {filter_triangle, 1},
+    [RESAMPLE_BOX] = {filter_box, 0.5},
+    [RESAMPLE_LANCZOS3] = {filter_lanczos3, 3},
+};
+
+static void resample_axis_free(resample_axis *axis) {
+    free(axis->start);
+    free(axis->weight);
+}
+
+// pixel centers are at +0.5, and a dst pixel's center maps to
+// (i + 0.5) * scale in the src. taps that fall off the edge are dropped
+// and the rest renormalized, and windows are moved back inside the src,
+// with zero weights filling them up.
+static bool resample_axis_new(resample_axis *axis, uint32_t src, uint32_t dst, resample_filter filter) {
+    double scale = (double)src / dst;
+    double stretch = scale > 1 ? scale : 1;
+    double support = filters[filter].support * stretch;
+    uint32_t taps = (uint32_t)ceil(support) * 2 + 1;
+    if (taps > src) {
+        taps = src;
+    }
+    axis->taps = taps;
+    axis->start = malloc(dst * sizeof(uint32_t));
+    axis->weight = calloc((size_t)dst * taps, sizeof(float));
+    double *w = malloc(taps * sizeof(double));
+    if (! axis->start || ! axis->weight || ! w) {
+        fprintf(stderr, "resample(): Out of memory for %u taps\n", taps);
+        resample_axis_free(axis);
+        free(w);
+        return false;
+    }
+    for (uint32_t i = 0; i < dst; i++) {
+        double center = (i + 0.5) * scale;
+        int64_t lo = (int64_t)floor(center - support), hi = (int64_t)ceil(center + support);
+        lo = lo < 0 ? 0 : lo;
+        hi = hi > src ? src : hi;
+        uint32_t start = lo + taps > src ? src - taps : lo;
+        double sum = 0;
+        memset(w, 0, taps * sizeof(double));
+        for (int64_t j = lo; j < hi; j++) {
+            w[j - start] = filters[filter].fn((j + 0.5 - center) / stretch);
+            sum += w[j - start];
+        }
+        for (uint32_t t = 0; t < taps; t++) {
+            axis->weight[(size_t)i * taps + t] = sum ? w[t] / sum : 0;
+        }
+        axis->start[i] = start;
+    }
+    free(w);
+    return true;
+}
+
+static void resample_nearest_band(void *ctx, uint32_t index) {
+    resample_job *job = ctx;
+    uint32_t begin = index * job->rows;
+    uint32_t end = begin + job->rows < job->dst_height ? begin + job->rows : job->dst_height;
+    for (uint32_t y = begin; y < end; y++) {
+        uint32_t sy = ((uint64_t)y * 2 + 1) * job->src_height / (2 * (uint64_t)job->dst_height);
+        const uint8_t *src = job->src + sy * job->src_pitch;
+        uint8_t *dst = job->dst + y * job->dst_pitch;
+        // constant sizes let the compiler turn the copies into moves
+        #define copy(size)                                             \
+            case size:                                                 \
+                for (uint32_t x = 0; x < job->dst_width; x++) {        \
+                    memcpy(dst + x * size, src + job->column[x], size); \
+                }                                                      \
+                break;
+        switch (job->pixel_size) {
+            copy(1);
+            copy(2);
+            copy(3);
+            copy(4);
+            copy(8);
+            copy(16);
+            default:
+                for (uint32_t x = 0; x < job->dst_width; x++) {
+                    memcpy(dst + x * job->pixel_size, src + job->column[x], job->pixel_size);
+                }
+                break;
+        }
+        #undef copy
+    }
+}
+
+static void resample_halve_band(void *ctx, uint32_t index) {
+    resample_job *job = ctx;
+    const pixel_kernels *kernels = pixel_kernels_get();
+    uint32_t begin = index * job->rows;
+    uint32_t end = begin + job->rows < job->dst_height ? begin + job->rows : job->dst_height;
+    for (uint32_t y = begin; y < end; y++) {
+        const uint8_t *a = job->src + (size_t)y * 2 * job->src_pitch;
+        kernels->halve8(a, a + job->src_pitch, job->dst + y * job->dst_pitch,
+                        job->dst_width, job->channels);
+    }
+}
+
+static void resample_double_band(void *ctx, uint32_t index) {
+    resample_job *job = ctx;
+    const pixel_kernels *kernels = pixel_kernels_get();
+    uint32_t begin = index * job->rows;
+    uint32_t end = begin + job->rows < job->dst_height ? begin + job->rows : job->dst_height;
+    for (uint32_t y = begin; y < end; y++) {
+        // even rows sit a quarter pixel above their src row, odd ones below
+        uint32_t near = y / 2;
+        uint32_t far = y & 1 ? (near + 1 < job->src_height ? near + 1 : near) : (near ? near - 1 : 0);
+        kernels->double8(job->src + near * job->src_pitch, job->src + far * job->src_pitch,
+                         job->dst + y * job->dst_pitch, job->src_width, job->channels);
+    }
+}
+
+static void resample_h_band(void *ctx, uint32_t index) {
+    resample_job *job = ctx;
+    const pixel_kernels *kernels = pixel_kernels_get();
+    uint32_t begin = index * job->rows;
+    uint32_t end = begin + job->rows < job->src_height ? begin + job->rows : job->src_height;
+    size_t pitch = (size_t)job->dst_width * job->channels;
+    size_t n = (size_t)job->src_width * job->channels;
+    // byte rows are widened once up front rather than for every tap, or
+    // read as they are if there's no memory for that
+    float *row = job->bytes ? malloc(n * sizeof(float)) : NULL;
+    for (uint32_t y = begin; y < end; y++) {
+        const uint8_t *src = job->src + y * job->src_pitch;
+        if (row) {
+            for (size_t i = 0; i < n; i++) {
+                row[i] = src[i];
+            }
+        }
+        kernels->resample_h(row ? (const void *)row : src, job->bytes && ! row, job->tmp + y * pitch,
+                            job->dst_width, job->channels, job->x.start, job->x.weight, job->x.taps);
+    }
+    free(row);
+}
+
+static void resample_v_band(void *ctx, uint32_t index) {
+    resample_job *job = ctx;
+    const pixel_kernels *kernels = pixel_kernels_get();
+    uint32_t begin = index * job->rows;
+    uint32_t end = begin + job->rows < job->dst_height ? begin + job->rows : job->dst_height;
+    size_t pitch = (size_t)job->dst_width * job->channels;
+    for (uint32_t y = begin; y < end; y++) {
+        kernels->resample_v(job->tmp + job->y.start[y] * pitch, pitch,
+                            job->y.weight + (size_t)y * job->y.taps, job->y.taps,
+                            job->dst + y * job->dst_pitch, job->bytes, pitch);
+    }
+}
+
+// runs fn for every band of height rows, serially for small images
+static void resample_run(resample_job *job, pool_fn fn, uint32_t width, uint32_t height) {
+    job->rows = RESAMPLE_BAND / width ? RESAMPLE_BAND / width : 1;
+    uint32_t bands = (height + job->rows - 1) / job->rows;
+    if ((size_t)width * height < RESAMPLE_PARALLEL) {
+        for (uint32_t i = 0; i < bands; i++) {
+            fn(job, i);
+        }
+    } else {
+        pool_run(pool_default(), fn, job, bands);
+    }
+}
+
+bool resample(const void *src, uint32_t src_width, uint32_t src_height, size_t src_pitch,
+              void *dst, uint32_t dst_width, uint32_t dst_height, size_t dst_pitch,
+              uint32_t format, uint32_t type, resample_filter filter) {
+    uint32_t pixel_size = gl_pixel_sizeof(format, type);
+    if (! pixel_size) {
+        return false;
+    }
+    if (!src_width || !src_height || !dst_width || !dst_height) {
+        fprintf(stderr, "resample(): Can't scale %ux%u to %ux%u\n",
+                src_width, src_height, dst_width, dst_height);
+        return false;
+    }
+    if (filter < RESAMPLE_NEAREST || filter > RESAMPLE_LANCZOS3) {
+        fprintf(stderr, "resample(): Unknown filter %d\n", filter);
+        return false;
+    }
+    if (filter != RESAMPLE_NEAREST && type != GL_UNSIGNED_BYTE && type != GL_FLOAT) {
+        fprintf(stderr, "resample(): Unsupported type %s for filtering\n", gl_str(type));
+        return false;
+    }
+
+    resample_job job = {
+        .src = src, .dst = dst,
+        .src_width = src_width, .src_height = src_height,
+        .dst_width = dst_width, .dst_height = dst_height,
+        .src_pitch = src_pitch ? src_pitch : (size_t)src_width * pixel_size,
+        .dst_pitch = dst_pitch ? dst_pitch : (size_t)dst_width * pixel_size,
+        .pixel_size = pixel_size,
+        .channels = pixel_size / gl_sizeof(type),
+        .bytes = type == GL_UNSIGNED_BYTE,
+    };
+
+    if (filter == RESAMPLE_NEAREST) {
+        size_t *column = malloc(dst_width * sizeof(size_t));
+        if (! column) {
+            fprintf(stderr, "resample(): Out of memory for %u columns\n", dst_width);
+            return false;
+        }
+        for (uint32_t x = 0; x < dst_width; x++) {
+            uint32_t sx = ((uint64_t)x * 2 + 1) * src_width / (2 * (uint64_t)dst_width);
+            column[x] = (size_t)sx * pixel_size;
+        }
+        job.column = column;
+        resample_run(&job, resample_nearest_band, dst_width, dst_height);
+        free(column);
+        return true;
+    }
+
+    // exact halving and doubling have fixed weights, which the kernels
+    // apply in integers. the results match the separable passes.
+    if (job.bytes && filter == RESAMPLE_BOX &&
+        src_width == 2 * dst_width && src_height == 2 * dst_height) {
+        resample_run(&job, resample_halve_band, dst_width, dst_height);
+        return true;
+    }
+    if (job.bytes && filter == RESAMPLE_BILINEAR &&
+        dst_width == 2 * src_width && dst_height == 2 * src_height) {
+        resample_run(&job, resample_double_band, dst_width, dst_height);
+        return true;
+    }
+
+    job.tmp = malloc((size_t)dst_width * src_height * job.channels * sizeof(float));
+    if (! job.tmp) {
+        fprintf(stderr, "resample(): Out of memory for %ux%u pass\n", dst_width, src_height);
+        return false;
+    }
+    if (! resample_axis_new(&job.x, src_width, dst_width, filter)) {
+        free(job.tmp);
+        return false;
+    }
+    if (! resample_axis_new(&job.y, src_height, dst_height, filter)) {
+        resample_axis_free(&job.x);
+        free(job.tmp);
+        return false;
+    }
+    resample_run(&job, resample_h_band, dst_width, src_height);
+    resample_run(&job, resample_v_band, dst_width, dst_height);
+    resample_axis_free(&job.x);
+    resample_axis_free(&job.y);
+    free(job.tmp);
+    return true;
+}
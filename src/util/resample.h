@@ -0,0 +1,25 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    RESAMPLE_NEAREST,
+    RESAMPLE_BILINEAR,
+    RESAMPLE_BOX,
+    RESAMPLE_LANCZOS3,
+} resample_filter;
+
+// scales a src_width x src_height image to dst_width x dst_height, each
+// axis on its own, with rows pitch bytes apart (0 for tightly packed).
+// nearest works on any pixel type, the other filters need GL_UNSIGNED_BYTE
+// or GL_FLOAT components. when shrinking, the filters are widened to cover
+// every src pixel.
+bool resample(const void *src, uint32_t src_width, uint32_t src_height, size_t src_pitch,
+              void *dst, uint32_t dst_width, uint32_t dst_height, size_t dst_pitch,
+              uint32_t format, uint32_t type, resample_filter filter);
+
+#endif
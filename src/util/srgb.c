@@ -0,0 +1,34 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+
+#include "srgb.h"
+
+static srgb_tables_t tables;
+
+// the exact IEC 61966-2-1 curves, only ever run to fill the tables
+static double srgb_decode_exact(double v) {
+    return v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double srgb_encode_exact(double v) {
+    return v <= 0.0031308 ? v * 12.92 : 1.055 * pow(v, 1 / 2.4) - 0.055;
+}
+
+static void srgb_tables_init() {
+    for (int i = 0; i < 256; i++) {
+        double linear = srgb_decode_exact(i / 255.0);
+        tables.to_linear[i] = linear;
+        tables.to_linear12[i] = (uint16_t)(linear * SRGB_LINEAR_MAX + 0.5);
+    }
+    for (int i = 0; i <= SRGB_LINEAR_MAX; i++) {
+        tables.from_linear12[i] = (uint8_t)(srgb_encode_exact((double)i / SRGB_LINEAR_MAX) * 255 + 0.5);
+    }
+}
+
+const srgb_tables_t *srgb_tables() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, srgb_tables_init);
+    return &tables;
+}
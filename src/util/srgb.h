@@ -0,0 +1,32 @@
+#ifndef SRGB_H
+#define SRGB_H
+
+#include <stdint.h>
+
+// linear values in 12 bits are fine enough that every sRGB byte survives
+// a trip through them
+#define SRGB_LINEAR_BITS 12
+#define SRGB_LINEAR_MAX ((1 << SRGB_LINEAR_BITS) - 1)
+
+typedef struct {
+    // sRGB byte to linear, in [0, 1] and in 12 bits
+    float to_linear[256];
+    uint16_t to_linear12[256];
+    // 12 bit linear to the nearest sRGB byte
+    uint8_t from_linear12[SRGB_LINEAR_MAX + 1];
+} srgb_tables_t;
+
+// built on first use
+extern const srgb_tables_t *srgb_tables();
+
+static inline uint8_t srgb_encode(const srgb_tables_t *tables, float linear) {
+    if (linear <= 0) {
+        return 0;
+    }
+    if (linear >= 1) {
+        return 255;
+    }
+    return tables->from_linear12[(uint32_t)(linear * SRGB_LINEAR_MAX + 0.5f)];
+}
+
+#endif
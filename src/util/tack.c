@@ -55,6 +55,12 @@ void tack_clear(tack_t *stack) {
     stack->len = 0;
 }
 
+// empties the stack but keeps its storage for the next round of pushes
+void tack_reset(tack_t *stack) {
+    stack->len = 0;
+    stack->pos = 0;
+}
+
 int tack_len(tack_t *stack) {
     return stack->len;
 }
@@ -31,6 +31,12 @@
 
 
 
+// simd8f uses AVX when the compiler targets it, and pairs of simd4f otherwise
+#if defined(VECTORIAL_SSE) && defined(__AVX__) && !defined(VECTORIAL_NO_AVX)
+    #define VECTORIAL_AVX
+#endif
+
+
 #ifdef VECTORIAL_SCALAR
     #define VECTORIAL_SIMD_TYPE "scalar"
 #endif
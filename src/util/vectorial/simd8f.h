@@ -0,0 +1,25 @@
+/*
+  Vectorial
+  8-wide companion to simd4f.
+  Licensed under the terms of the two-clause BSD License (see LICENSE)
+*/
+
+#ifndef VECTORIAL_SIMD8F_H
+#define VECTORIAL_SIMD8F_H
+
+#ifndef VECTORIAL_CONFIG_H
+  #include "vectorial/config.h"
+#endif
+
+#include "vectorial/simd4f.h"
+
+// AVX gets native 256 bit registers, everything else runs a pair of simd4f.
+// either way lanes 0-3 are the low half and 4-7 the high half, and the
+// 4x4 transposes work within each half like two interleaved simd4x4f.
+#ifdef VECTORIAL_AVX
+    #include "simd8f_avx.h"
+#else
+    #include "simd8f_pair.h"
+#endif
+
+#endif
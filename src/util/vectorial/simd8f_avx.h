@@ -0,0 +1,90 @@
+/*
+  Vectorial
+  8-wide companion to simd4f.
+  Licensed under the terms of the two-clause BSD License (see LICENSE)
+*/
+#ifndef VECTORIAL_SIMD8F_AVX_H
+#define VECTORIAL_SIMD8F_AVX_H
+
+#include <immintrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef __m256 simd8f;
+
+// creating
+
+vectorial_inline simd8f simd8f_create(float a, float b, float c, float d,
+                                      float e, float f, float g, float h) {
+    return _mm256_setr_ps(a, b, c, d, e, f, g, h);
+}
+
+vectorial_inline simd8f simd8f_zero() { return _mm256_setzero_ps(); }
+
+vectorial_inline simd8f simd8f_splat(float v) { return _mm256_set1_ps(v); }
+
+vectorial_inline simd8f simd8f_combine(simd4f lo, simd4f hi) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+vectorial_inline simd8f simd8f_uload8(const float *ary) {
+    return _mm256_loadu_ps(ary);
+}
+
+vectorial_inline void simd8f_ustore8(const simd8f val, float *ary) {
+    _mm256_storeu_ps(ary, val);
+}
+
+vectorial_inline simd4f simd8f_get_low(simd8f s) { return _mm256_castps256_ps128(s); }
+vectorial_inline simd4f simd8f_get_high(simd8f s) { return _mm256_extractf128_ps(s, 1); }
+
+// math
+
+vectorial_inline simd8f simd8f_add(simd8f lhs, simd8f rhs) { return _mm256_add_ps(lhs, rhs); }
+vectorial_inline simd8f simd8f_sub(simd8f lhs, simd8f rhs) { return _mm256_sub_ps(lhs, rhs); }
+vectorial_inline simd8f simd8f_mul(simd8f lhs, simd8f rhs) { return _mm256_mul_ps(lhs, rhs); }
+vectorial_inline simd8f simd8f_div(simd8f lhs, simd8f rhs) { return _mm256_div_ps(lhs, rhs); }
+
+vectorial_inline simd8f simd8f_madd(simd8f m1, simd8f m2, simd8f a) {
+#ifdef __FMA__
+    return _mm256_fmadd_ps(m1, m2, a);
+#else
+    return simd8f_add(simd8f_mul(m1, m2), a);
+#endif
+}
+
+vectorial_inline simd8f simd8f_reciprocal(simd8f v) {
+    simd8f s = _mm256_rcp_ps(v);
+    const simd8f two = simd8f_splat(2.0f);
+    s = simd8f_mul(s, simd8f_sub(two, simd8f_mul(v, s)));
+    return s;
+}
+
+vectorial_inline simd8f simd8f_min(simd8f a, simd8f b) { return _mm256_min_ps(a, b); }
+vectorial_inline simd8f simd8f_max(simd8f a, simd8f b) { return _mm256_max_ps(a, b); }
+
+// shuffling
+
+// transposes the 4x4 matrix in each half, as _MM_TRANSPOSE4_PS does
+vectorial_inline void simd8f_transpose4(simd8f *a, simd8f *b, simd8f *c, simd8f *d) {
+    simd8f t0 = _mm256_unpacklo_ps(*a, *b);
+    simd8f t1 = _mm256_unpacklo_ps(*c, *d);
+    simd8f t2 = _mm256_unpackhi_ps(*a, *b);
+    simd8f t3 = _mm256_unpackhi_ps(*c, *d);
+    *a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    *b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    *c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    *d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,94 @@
+/*
+  Vectorial
+  8-wide companion to simd4f.
+  Licensed under the terms of the two-clause BSD License (see LICENSE)
+*/
+#ifndef VECTORIAL_SIMD8F_PAIR_H
+#define VECTORIAL_SIMD8F_PAIR_H
+
+#include "vectorial/simd4x4f.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef struct {
+    simd4f lo, hi;
+} simd8f;
+
+// creating
+
+vectorial_inline simd8f simd8f_combine(simd4f lo, simd4f hi) {
+    simd8f s = { lo, hi };
+    return s;
+}
+
+vectorial_inline simd8f simd8f_create(float a, float b, float c, float d,
+                                      float e, float f, float g, float h) {
+    return simd8f_combine(simd4f_create(a, b, c, d), simd4f_create(e, f, g, h));
+}
+
+vectorial_inline simd8f simd8f_zero() { return simd8f_combine(simd4f_zero(), simd4f_zero()); }
+
+vectorial_inline simd8f simd8f_splat(float v) { return simd8f_combine(simd4f_splat(v), simd4f_splat(v)); }
+
+vectorial_inline simd8f simd8f_uload8(const float *ary) {
+    return simd8f_combine(simd4f_uload4(ary), simd4f_uload4(ary + 4));
+}
+
+vectorial_inline void simd8f_ustore8(const simd8f val, float *ary) {
+    simd4f_ustore4(val.lo, ary);
+    simd4f_ustore4(val.hi, ary + 4);
+}
+
+vectorial_inline simd4f simd8f_get_low(simd8f s) { return s.lo; }
+vectorial_inline simd4f simd8f_get_high(simd8f s) { return s.hi; }
+
+// math
+
+#define VECTORIAL_SIMD8F_PAIRWISE(name)                          \
+    vectorial_inline simd8f simd8f_##name(simd8f lhs, simd8f rhs) { \
+        return simd8f_combine(simd4f_##name(lhs.lo, rhs.lo),        \
+                              simd4f_##name(lhs.hi, rhs.hi));       \
+    }
+
+VECTORIAL_SIMD8F_PAIRWISE(add)
+VECTORIAL_SIMD8F_PAIRWISE(sub)
+VECTORIAL_SIMD8F_PAIRWISE(mul)
+VECTORIAL_SIMD8F_PAIRWISE(div)
+VECTORIAL_SIMD8F_PAIRWISE(min)
+VECTORIAL_SIMD8F_PAIRWISE(max)
+
+#undef VECTORIAL_SIMD8F_PAIRWISE
+
+vectorial_inline simd8f simd8f_madd(simd8f m1, simd8f m2, simd8f a) {
+    return simd8f_combine(simd4f_madd(m1.lo, m2.lo, a.lo), simd4f_madd(m1.hi, m2.hi, a.hi));
+}
+
+vectorial_inline simd8f simd8f_reciprocal(simd8f v) {
+    return simd8f_combine(simd4f_reciprocal(v.lo), simd4f_reciprocal(v.hi));
+}
+
+// shuffling
+
+// transposes the 4x4 matrix in each half
+vectorial_inline void simd8f_transpose4(simd8f *a, simd8f *b, simd8f *c, simd8f *d) {
+    simd4x4f lo = simd4x4f_create(a->lo, b->lo, c->lo, d->lo);
+    simd4x4f hi = simd4x4f_create(a->hi, b->hi, c->hi, d->hi);
+    simd4x4f_transpose_inplace(&lo);
+    simd4x4f_transpose_inplace(&hi);
+    *a = simd8f_combine(lo.x, hi.x);
+    *b = simd8f_combine(lo.y, hi.y);
+    *c = simd8f_combine(lo.z, hi.z);
+    *d = simd8f_combine(lo.w, hi.w);
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif